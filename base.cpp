@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -164,6 +165,90 @@ void *arrayGet(Array *arr, int i)
 
 /* ------  ------ */
 
+/* ------ ڴؿʼ ------ */
+
+struct ArenaBlock {
+	ArenaBlock *next;
+	double data[1]; /* ݴ￪ʼ, 8ֽڶ */
+};
+
+#define ARENA_ALIGN(n) (((n) + 7) & ~7)
+
+void arenaInit(Arena *a, int blockSize)
+{
+	assert(a && blockSize > 0);
+	a->blocks = 0;
+	a->cur = 0;
+	a->end = 0;
+	a->blockSize = ARENA_ALIGN(blockSize);
+}
+
+void arenaFree(Arena *a)
+{
+	if (!a)
+		return;
+	while (a->blocks) {
+		ArenaBlock *next = a->blocks->next;
+		free(a->blocks);
+		a->blocks = next;
+	}
+	a->cur = 0;
+	a->end = 0;
+}
+
+void *arenaAlloc(Arena *a, int size)
+{
+	assert(a && size >= 0);
+	size = ARENA_ALIGN(size);
+	if (a->end - a->cur < size) {
+		/* ȿ黹Ķ󵥶һ */
+		int bytes = size > a->blockSize ? size : a->blockSize;
+		ArenaBlock *b = (ArenaBlock *)malloc(offsetof(ArenaBlock, data) + bytes);
+		if (!b)
+			return 0;
+		b->next = a->blocks;
+		a->blocks = b;
+		a->cur = (char *)b->data;
+		a->end = a->cur + bytes;
+	}
+	void *mem = a->cur;
+	a->cur += size;
+	return mem;
+}
+
+int stringInitArena(String *s, Arena *a, const char *str, int len)
+{
+	assert(s && len >= 0);
+	s->data = (char *)arenaAlloc(a, len + 1);
+	if (!s->data) {
+		s->capacity = s->size = 0;
+		return -1;
+	}
+	memcpy(s->data, str, len);
+	s->data[len] = '\0';
+	s->size = len;
+	s->capacity = len + 1;
+	return 0;
+}
+
+int arrayMoveToArena(Array *arr, Arena *a)
+{
+	assert(arr);
+	void *data = 0;
+	if (arr->size > 0) {
+		data = arenaAlloc(a, arr->objectSize * arr->size);
+		if (!data)
+			return -1;
+		memcpy(data, arr->data, arr->objectSize * arr->size);
+	}
+	free(arr->data);
+	arr->data = data;
+	arr->capacity = arr->size;
+	return 0;
+}
+
+/* ------ ڴؽ ------ */
+
 /* ------ ϣʼ ------ */
 
 int cstrCmp(const void *key1, const void *key2)
@@ -308,7 +393,7 @@ int hashTableInsert(HashTable *ht, const void *key, void *value, void **oldvalue
 		}
 		hashTableFree(ht);
 		*ht = ht2;
-		h = h % ht->dataCapacity;
+		h = hashTableHash(ht, key);
 	}
 	assert(h >= 0 && (int)h < ht->dataCapacity);
 	hashTableInsertWithHash(ht, h, key, value);
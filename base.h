@@ -10,6 +10,8 @@
 #define atoll _atoi64
 #define strtoull _strtoi64
 #define isnan _isnan
+#define snprintf _snprintf
+#define signbit(x) (_copysign(1.0, (x)) < 0)
 
 #else
 /* */
@@ -73,6 +75,31 @@ void *arrayGet(Array *arr, int i);
 
 /* ------  ------ */
 
+/* ------ ڴؿʼ ------ */
+
+/* һ𴴽һͷŵС(ASTĽڵ)ڴ: ʱֻƶָ,
+ * ǰʱһ, ܵͷ, arenaFreeһȫͷ */
+typedef struct ArenaBlock ArenaBlock;
+typedef struct {
+	ArenaBlock *blocks; /* Ŀ, µǰ */
+	char *cur; /* ǰпеĿʼ */
+	char *end;
+	int blockSize;
+} Arena;
+
+void arenaInit(Arena *a, int blockSize);
+/* ͷźԼ */
+void arenaFree(Arena *a);
+
+/* 8ֽڶ, ʧܷ0 */
+void *arenaAlloc(Arena *a, int size);
+/* dataarena, stringAddstringFree */
+int stringInitArena(String *s, Arena *a, const char *str, int len);
+/* Ƶarena, ֮arrayAddarrayFree */
+int arrayMoveToArena(Array *arr, Arena *a);
+
+/* ------ ڴؽ ------ */
+
 /* ------ ϣʼ ------ */
 
 /* char *Ϊؼ */
@@ -0,0 +1,167 @@
+/* parserGenerateBuiltin, Ҫ޸. ޸Ĺʽinterp builtin */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <limits>
+
+#include "indicators.h"
+#include "plugin.h"
+#include "vm.h"
+
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+using namespace tg;
+
+namespace {
+
+struct State {
+	Value *R[19];
+	unsigned int seen[7];
+};
+
+static const FusedExpr FE0 = { 2, { 0, 0 } };
+
+static void loop0(const double *const *base, double *__restrict r, long n)
+{
+	const double *x0 = base[0];
+	const double *x1 = base[1];
+	for (long i = 0; i < n; ++i) {
+		const double v0 = x0[i];
+		const double v1 = 3;
+		const double v2 = v0 * v1;
+		const double v3 = x1[i];
+		const double v4 = 2;
+		const double v5 = v3 * v4;
+		const double v6 = v2 - v5;
+		r[i] = v6;
+	}
+}
+
+static const char *const STMT_NAMES[] = {
+	"N",
+	"M1",
+	"M2",
+	"RSV",
+	"K",
+	"D",
+	"J",
+	0
+};
+
+static const int STMT_REGS[] = { 0, 1, 0, 11, 13, 14, 18, -1 };
+
+static void destroy(void *state)
+{
+	if (!state)
+		return;
+	Value **R = ((State *)state)->R;
+	valueFree(R[0]);
+	valueFree(R[1]);
+	valueFree(R[11]);
+	valueFree(R[13]);
+	valueFree(R[14]);
+	valueFree(R[18]);
+	free(state);
+}
+
+static void *create()
+{
+	State *state = (State *)calloc(1, sizeof(State));
+	if (!state)
+		return 0;
+	Value **R = state->R;
+	if (!(R[0] = valueNew(VT_INT)))
+		goto fail;
+	R[0]->i = 3;
+	if (!(R[1] = valueNew(VT_INT)))
+		goto fail;
+	R[1]->i = 9;
+	(void)R;
+	return state;
+fail:
+	destroy(state);
+	return 0;
+}
+
+static int run(void *state, void *parser)
+{
+	Value **R = ((State *)state)->R;
+	unsigned int *seen = ((State *)state)->seen, sum;
+	const Value *argv[3];
+	(void)argv;
+	(void)parser;
+	(void)seen;
+	(void)sum;
+	R[2] = CLOSE(parser);
+	R[3] = LOW(parser);
+	R[6] = HIGH(parser);
+	sum = 1 + valueVersion(R[2]) + valueVersion(R[6]) + valueVersion(R[3]);
+	if (seen[3] == sum)
+		goto L3;
+	seen[3] = sum;
+	R[11] = idiomRSV(R[2], R[6], R[3], 3, 100, R[11]);
+	if (R[11])
+		R[11]->version++;
+L3:
+	sum = 1 + valueVersion(R[11]);
+	if (seen[4] == sum)
+		goto L4;
+	seen[4] = sum;
+	R[13] = SMA(R[11], 9, 1, R[13]);
+	if (R[13])
+		R[13]->version++;
+L4:
+	sum = 1 + valueVersion(R[13]);
+	if (seen[5] == sum)
+		goto L5;
+	seen[5] = sum;
+	R[14] = SMA(R[13], 3, 1, R[14]);
+	if (R[14])
+		R[14]->version++;
+L5:
+	sum = 1 + valueVersion(R[13]) + valueVersion(R[14]);
+	if (seen[6] == sum)
+		goto L6;
+	seen[6] = sum;
+	argv[0] = R[13];
+	argv[1] = R[14];
+	R[18] = fusedRun(&FE0, argv, loop0, R[18]);
+	if (R[18])
+		R[18]->version++;
+L6:
+	return 0;
+}
+
+static Value *stmtValue(void *state, int i)
+{
+	if (i < 0 || i >= 7)
+		return 0;
+	return ((State *)state)->R[STMT_REGS[i]];
+}
+
+static const FormulaPlugin PLUGIN = {
+	PLUGIN_VERSION,
+	"KDJ",
+	3136834001u,
+	7,
+	STMT_NAMES,
+	create,
+	destroy,
+	run,
+	stmtValue,
+	4,
+};
+
+}
+
+namespace tg {
+
+const FormulaPlugin *builtinFormula_KDJ()
+{
+	return &PLUGIN;
+}
+
+}
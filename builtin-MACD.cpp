@@ -0,0 +1,159 @@
+/* parserGenerateBuiltin, Ҫ޸. ޸Ĺʽinterp builtin */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <limits>
+
+#include "indicators.h"
+#include "plugin.h"
+#include "vm.h"
+
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+using namespace tg;
+
+namespace {
+
+struct State {
+	Value *R[11];
+	unsigned int seen[4];
+};
+
+static const FusedExpr FE0 = { 2, { 0, 0 } };
+
+static void loop0(const double *const *base, double *__restrict r, long n)
+{
+	const double *x0 = base[0];
+	const double *x1 = base[1];
+	for (long i = 0; i < n; ++i) {
+		const double v0 = x0[i];
+		const double v1 = x1[i];
+		const double v2 = v0 - v1;
+		const double v3 = 2;
+		const double v4 = v2 * v3;
+		r[i] = v4;
+	}
+}
+
+static const char *const STMT_NAMES[] = {
+	"SHORT",
+	"LONG",
+	"MID",
+	"DIF",
+	"DEA",
+	"MACD",
+	0
+};
+
+static const int STMT_REGS[] = { 0, 1, 2, 6, 7, 10, -1 };
+
+static void destroy(void *state)
+{
+	if (!state)
+		return;
+	Value **R = ((State *)state)->R;
+	valueFree(R[0]);
+	valueFree(R[1]);
+	valueFree(R[2]);
+	valueFree(R[4]);
+	valueFree(R[5]);
+	valueFree(R[6]);
+	valueFree(R[7]);
+	valueFree(R[10]);
+	free(state);
+}
+
+static void *create()
+{
+	State *state = (State *)calloc(1, sizeof(State));
+	if (!state)
+		return 0;
+	Value **R = state->R;
+	if (!(R[0] = valueNew(VT_INT)))
+		goto fail;
+	R[0]->i = 12;
+	if (!(R[1] = valueNew(VT_INT)))
+		goto fail;
+	R[1]->i = 26;
+	if (!(R[2] = valueNew(VT_INT)))
+		goto fail;
+	R[2]->i = 9;
+	(void)R;
+	return state;
+fail:
+	destroy(state);
+	return 0;
+}
+
+static int run(void *state, void *parser)
+{
+	Value **R = ((State *)state)->R;
+	unsigned int *seen = ((State *)state)->seen, sum;
+	const Value *argv[3];
+	(void)argv;
+	(void)parser;
+	(void)seen;
+	(void)sum;
+	R[3] = CLOSE(parser);
+	sum = 1 + valueVersion(R[3]) + valueVersion(R[4]) + valueVersion(R[5]);
+	if (seen[1] == sum)
+		goto L1;
+	seen[1] = sum;
+	R[6] = idiomDIF(R[3], 12, 26, &R[4], &R[5], R[6]);
+	if (R[6])
+		R[6]->version++;
+L1:
+	sum = 1 + valueVersion(R[6]);
+	if (seen[2] == sum)
+		goto L2;
+	seen[2] = sum;
+	R[7] = EMA(R[6], 9, R[7]);
+	if (R[7])
+		R[7]->version++;
+L2:
+	sum = 1 + valueVersion(R[6]) + valueVersion(R[7]);
+	if (seen[3] == sum)
+		goto L3;
+	seen[3] = sum;
+	argv[0] = R[6];
+	argv[1] = R[7];
+	R[10] = fusedRun(&FE0, argv, loop0, R[10]);
+	if (R[10])
+		R[10]->version++;
+L3:
+	return 0;
+}
+
+static Value *stmtValue(void *state, int i)
+{
+	if (i < 0 || i >= 6)
+		return 0;
+	return ((State *)state)->R[STMT_REGS[i]];
+}
+
+static const FormulaPlugin PLUGIN = {
+	PLUGIN_VERSION,
+	"MACD",
+	1589335838u,
+	6,
+	STMT_NAMES,
+	create,
+	destroy,
+	run,
+	stmtValue,
+	2,
+};
+
+}
+
+namespace tg {
+
+const FormulaPlugin *builtinFormula_MACD()
+{
+	return &PLUGIN;
+}
+
+}
@@ -0,0 +1,165 @@
+/* parserGenerateBuiltin, Ҫ޸. ޸Ĺʽinterp builtin */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <limits>
+
+#include "indicators.h"
+#include "plugin.h"
+#include "vm.h"
+
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+using namespace tg;
+
+namespace {
+
+struct State {
+	Value *R[23];
+	unsigned int seen[6];
+};
+
+static const char *const STMT_NAMES[] = {
+	"N1",
+	"N2",
+	"N3",
+	"LC",
+	"RSI1",
+	"RSI2",
+	"RSI3",
+	0
+};
+
+static const int STMT_REGS[] = { 0, 1, 2, 5, 14, 18, 22, -1 };
+
+static void destroy(void *state)
+{
+	if (!state)
+		return;
+	Value **R = ((State *)state)->R;
+	valueFree(R[0]);
+	valueFree(R[1]);
+	valueFree(R[2]);
+	valueFree(R[5]);
+	valueFree(R[6]);
+	valueFree(R[9]);
+	valueFree(R[11]);
+	valueFree(R[14]);
+	valueFree(R[15]);
+	valueFree(R[16]);
+	valueFree(R[18]);
+	valueFree(R[19]);
+	valueFree(R[20]);
+	valueFree(R[22]);
+	free(state);
+}
+
+static void *create()
+{
+	State *state = (State *)calloc(1, sizeof(State));
+	if (!state)
+		return 0;
+	Value **R = state->R;
+	if (!(R[0] = valueNew(VT_INT)))
+		goto fail;
+	R[0]->i = 6;
+	if (!(R[1] = valueNew(VT_INT)))
+		goto fail;
+	R[1]->i = 12;
+	if (!(R[2] = valueNew(VT_INT)))
+		goto fail;
+	R[2]->i = 24;
+	(void)R;
+	return state;
+fail:
+	destroy(state);
+	return 0;
+}
+
+static int run(void *state, void *parser)
+{
+	Value **R = ((State *)state)->R;
+	unsigned int *seen = ((State *)state)->seen, sum;
+	const Value *argv[3];
+	(void)argv;
+	(void)parser;
+	(void)seen;
+	(void)sum;
+	R[3] = CLOSE(parser);
+	sum = 1 + valueVersion(R[3]);
+	if (seen[1] == sum)
+		goto L1;
+	seen[1] = sum;
+	R[5] = REF(R[3], 1, R[5]);
+	if (R[5])
+		R[5]->version++;
+L1:
+	sum = 1 + valueVersion(R[3]) + valueVersion(R[5]);
+	if (seen[2] == sum)
+		goto L2;
+	seen[2] = sum;
+	if (R[3]->size && R[5]->size)
+		R[6] = suanShuYunSuan_AA(R[3], R[5], '-', R[6]);
+	if (R[6])
+		R[6]->version++;
+L2:
+	sum = 1 + valueVersion(R[6]) + valueVersion(R[9]) + valueVersion(R[11]);
+	if (seen[3] == sum)
+		goto L3;
+	seen[3] = sum;
+	R[14] = idiomRSI(R[6], 6, 1, 100, &R[9], &R[11], R[14]);
+	if (R[14])
+		R[14]->version++;
+L3:
+	sum = 1 + valueVersion(R[6]) + valueVersion(R[15]) + valueVersion(R[16]);
+	if (seen[4] == sum)
+		goto L4;
+	seen[4] = sum;
+	R[18] = idiomRSI(R[6], 12, 1, 100, &R[15], &R[16], R[18]);
+	if (R[18])
+		R[18]->version++;
+L4:
+	sum = 1 + valueVersion(R[6]) + valueVersion(R[19]) + valueVersion(R[20]);
+	if (seen[5] == sum)
+		goto L5;
+	seen[5] = sum;
+	R[22] = idiomRSI(R[6], 24, 1, 100, &R[19], &R[20], R[22]);
+	if (R[22])
+		R[22]->version++;
+L5:
+	return 0;
+}
+
+static Value *stmtValue(void *state, int i)
+{
+	if (i < 0 || i >= 7)
+		return 0;
+	return ((State *)state)->R[STMT_REGS[i]];
+}
+
+static const FormulaPlugin PLUGIN = {
+	PLUGIN_VERSION,
+	"RSI",
+	4232430031u,
+	7,
+	STMT_NAMES,
+	create,
+	destroy,
+	run,
+	stmtValue,
+	3,
+};
+
+}
+
+namespace tg {
+
+const FormulaPlugin *builtinFormula_RSI()
+{
+	return &PLUGIN;
+}
+
+}
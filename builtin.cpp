@@ -0,0 +1,66 @@
+#include "plugin.h"
+
+#include <string.h>
+
+namespace tg {
+
+/* ------ ùʽʼ ------ */
+
+/* ޸Ĺʽӹʽinterp builtin, builtin-XXX.cpp */
+
+static const char *RSI = ""
+	"N1:=6;\n"
+	"N2:=12;\n"
+	"N3:=24;\n"
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),N1,1)/SMA(ABS(CLOSE-LC),N1,1)*100;\n"
+	"RSI2:SMA(MAX(CLOSE-LC,0),N2,1)/SMA(ABS(CLOSE-LC),N2,1)*100;\n"
+	"RSI3:SMA(MAX(CLOSE-LC,0),N3,1)/SMA(ABS(CLOSE-LC),N3,1)*100;";
+
+static const char *KDJ = ""
+	"N:=3;\n"
+	"M1:=9;\n"
+	"M2:=3;\n"
+	"RSV:=(CLOSE-LLV(LOW,N))/(HHV(HIGH,N)-LLV(LOW,N))*100;\n"
+	"K:SMA(RSV,M1,1);\n"
+	"D:SMA(K,M2,1);\n"
+	"J:3*K-2*D;";
+
+static const char *MACD = ""
+	"SHORT:=12;\n"
+	"LONG:=26;\n"
+	"MID:=9;\n"
+	"DIF:EMA(CLOSE,SHORT)-EMA(CLOSE,LONG);\n"
+	"DEA:EMA(DIF,MID);\n"
+	"MACD:(DIF-DEA)*2;";
+
+/* builtin-XXX.cpp */
+const FormulaPlugin *builtinFormula_RSI();
+const FormulaPlugin *builtinFormula_KDJ();
+const FormulaPlugin *builtinFormula_MACD();
+
+static const BuiltinFormula BUILTINS[] = {
+	{ "RSI", RSI, builtinFormula_RSI },
+	{ "KDJ", KDJ, builtinFormula_KDJ },
+	{ "MACD", MACD, builtinFormula_MACD },
+};
+
+const BuiltinFormula *builtinFormulas(int *count)
+{
+	if (count)
+		*count = sizeof(BUILTINS)/sizeof(BUILTINS[0]);
+	return BUILTINS;
+}
+
+const BuiltinFormula *findBuiltinFormula(const char *name)
+{
+	for (unsigned i = 0; name && i < sizeof(BUILTINS)/sizeof(BUILTINS[0]); ++i) {
+		if (strcmp(BUILTINS[i].name, name) == 0)
+			return &BUILTINS[i];
+	}
+	return 0;
+}
+
+/* ------ ùʽ ------ */
+
+}
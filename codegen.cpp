@@ -0,0 +1,518 @@
+#include "plugin.h"
+
+#include <assert.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+#include "parser-impl.h"
+#include "vm.h"
+
+namespace tg {
+
+/* ------ ָƿʼ ------ */
+
+/* FNV-1a */
+static unsigned int hashBytes(unsigned int h, const void *data, int len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	for (int i = 0; i < len; ++i) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static unsigned int hashInt(unsigned int h, int i)
+{
+	return hashBytes(h, &i, sizeof(i));
+}
+
+static unsigned int hashDouble(unsigned int h, double f)
+{
+	return hashBytes(h, &f, sizeof(f));
+}
+
+/* ĵַÿжܲͬ, ע */
+static unsigned int hashFn(unsigned int h, const Instr *ins)
+{
+	const char *name = 0;
+	if (ins->op == OP_VAR)
+		name = findVariableName(ins->fn);
+	else if (ins->op == OP_CALL)
+		name = findFunctionName(ins->fn);
+	return name ? hashBytes(h, name, strlen(name)) : h;
+}
+
+unsigned int programFingerprint(Program *prog)
+{
+	unsigned int h = 2166136261u;
+	h = hashInt(h, prog->nregs);
+	for (int i = 0; i < prog->nregs; ++i) {
+		const Value *v = prog->regs[i];
+		if (!(prog->regFlags[i] & RF_CONST) || !v)
+			continue;
+		h = hashInt(h, i);
+		h = hashDouble(h, v->type == VT_INT ? v->i : v->f);
+	}
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		const Instr *ins = (const Instr *)arrayGet(&prog->instrs, i);
+		h = hashInt(h, ins->op);
+		h = hashInt(h, ins->dst);
+		h = hashInt(h, ins->a);
+		h = hashInt(h, ins->b);
+		h = hashInt(h, ins->n);
+		h = hashInt(h, ins->m);
+		h = hashDouble(h, ins->f);
+		h = hashFn(h, ins);
+	}
+	for (int i = 0; i < prog->operands.size; ++i) {
+		h = hashInt(h, *(const int *)arrayGet(&prog->operands, i));
+	}
+	for (int i = 0; i < prog->fused.size; ++i) {
+		const FusedExpr *fe = (const FusedExpr *)arrayGet(&prog->fused, i);
+		h = hashInt(h, fe->ninputs);
+		for (int j = 0; j < fe->ninputs; ++j) {
+			h = hashInt(h, fe->shifts[j]);
+		}
+		for (int k = 0; k < fe->ncode; ++k) {
+			h = hashInt(h, fe->code[k].op);
+			h = hashInt(h, fe->code[k].input);
+			h = hashDouble(h, fe->code[k].f);
+		}
+	}
+	for (int i = 0; i < prog->nstmts; ++i) {
+		h = hashInt(h, prog->stmtRegs[i]);
+	}
+	return h;
+}
+
+/* ------ ָƽ ------ */
+
+/* ------ C++뿪ʼ ------ */
+
+/* ֽC++, ںֱӵ, ںϵıʽչѭ,
+ * C++. programRunÿcaseһһӦ */
+
+struct CodeGen {
+	FILE *fp;
+	Program *prog;
+	int nfns; /* Ҫcreateвҵĺ */
+	bool builtin; /* ùʽ, ֱӵ */
+};
+
+/* õֱӵ */
+static const struct {
+	ValueFn fn;
+	const char *name;
+} QUOTE_VARS[] = {
+	{ I_OPEN, "OPEN" },
+	{ I_HIGH, "HIGH" },
+	{ I_LOW, "LOW" },
+	{ I_CLOSE, "CLOSE" },
+};
+
+/* õ±, -1 */
+static int quoteVar(ValueFn fn)
+{
+	for (int i = 0; i < (int)(sizeof(QUOTE_VARS)/sizeof(QUOTE_VARS[0])); ++i) {
+		if (QUOTE_VARS[i].fn == fn)
+			return i;
+	}
+	return -1;
+}
+
+/* ӡĳfȫͬ */
+static void genDouble(FILE *fp, double f)
+{
+	if (f != f)
+		fprintf(fp, "NAN");
+	else if (f > DBL_MAX)
+		fprintf(fp, "HUGE_VAL");
+	else if (f < -DBL_MAX)
+		fprintf(fp, "-HUGE_VAL");
+	else
+		fprintf(fp, "%.17g", f);
+}
+
+/* ֿGBK, ASCIIַð˽ת */
+static void genString(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+		if (*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20 || *p >= 0x7f)
+			fprintf(fp, "\\%03o", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+/* kںϵıʽչһѭ, ÿһĽھֲ */
+static int genFusedLoop(CodeGen *g, int k)
+{
+	FILE *fp = g->fp;
+	const FusedExpr *fe = (const FusedExpr *)arrayGet(&g->prog->fused, k);
+	int stack[MAX_FUSED_CODE];
+	int sp = 0;
+
+	fprintf(fp, "static const FusedExpr FE%d = { %d, {", k, fe->ninputs);
+	for (int j = 0; j < fe->ninputs; ++j) {
+		fprintf(fp, "%s %d", j ? "," : "", fe->shifts[j]);
+	}
+	fprintf(fp, " } };\n\n");
+
+	fprintf(fp, "static void loop%d(const double *const *base, double *__restrict r, long n)\n{\n", k);
+	for (int j = 0; j < fe->ninputs; ++j) {
+		fprintf(fp, "\tconst double *x%d = base[%d];\n", j, j);
+	}
+	fprintf(fp, "\tfor (long i = 0; i < n; ++i) {\n");
+	for (int v = 0; v < fe->ncode; ++v) {
+		const FusedCode *c = &fe->code[v];
+		int x = sp > 0 ? stack[sp - 1] : -1;
+		int y = x;
+		if (c->op >= FC_ADD && c->op <= FC_DIV) {
+			if (sp < 2)
+				return -1;
+			x = stack[sp - 2];
+			--sp;
+		} else if (c->op != FC_LOAD && c->op != FC_CONST && sp < 1) {
+			return -1;
+		}
+		fprintf(fp, "\t\tconst double v%d = ", v);
+		switch (c->op) {
+		case FC_LOAD:
+			fprintf(fp, "x%d[i]", c->input);
+			stack[sp++] = v;
+			break;
+		case FC_CONST:
+			genDouble(fp, c->f);
+			stack[sp++] = v;
+			break;
+		case FC_ADD: fprintf(fp, "v%d + v%d", x, y); break;
+		case FC_SUB: fprintf(fp, "v%d - v%d", x, y); break;
+		case FC_MUL: fprintf(fp, "v%d * v%d", x, y); break;
+		case FC_DIV: fprintf(fp, "v%d != 0 ? v%d / v%d : NAN", y, x, y); break;
+		case FC_MAX:
+			fprintf(fp, "v%d > ", x);
+			genDouble(fp, c->f);
+			fprintf(fp, " ? v%d : ", x);
+			genDouble(fp, c->f);
+			break;
+		case FC_ABS: fprintf(fp, "fabs(v%d)", x); break;
+		}
+		fprintf(fp, ";\n");
+		if (c->op != FC_LOAD && c->op != FC_CONST)
+			stack[sp - 1] = v;
+	}
+	if (sp != 1)
+		return -1;
+	fprintf(fp, "\t\tr[i] = v%d;\n\t}\n}\n\n", stack[0]);
+	return 0;
+}
+
+static void genArgs(CodeGen *g, const Instr *ins)
+{
+	const int *operands = (const int *)g->prog->operands.data;
+	for (int i = 0; i < ins->b; ++i) {
+		fprintf(g->fp, "\targv[%d] = R[%d];\n", i, operands[ins->a + i]);
+	}
+}
+
+/* programRunһ, İ汾ûб仯ʱiָĺ. ֻɲOP_CALL */
+static void genSkip(CodeGen *g, const Instr *ins, int i)
+{
+	int regs[MAX_ARGC];
+	int n = instrOperands(g->prog, ins, regs);
+	fprintf(g->fp, "\tsum = 1");
+	for (int j = 0; j < n; ++j) {
+		fprintf(g->fp, " + valueVersion(R[%d])", regs[j]);
+	}
+	fprintf(g->fp, ";\n\tif (seen[%d] == sum)\n\t\tgoto L%d;\n\tseen[%d] = sum;\n", i, i, i);
+}
+
+static int genInstr(CodeGen *g, const Instr *ins, int fn)
+{
+	FILE *fp = g->fp;
+	const int *args = (const int *)g->prog->operands.data + ins->a;
+	int d = ins->dst;
+	switch (ins->op) {
+	case OP_VAR:
+		if (quoteVar(ins->fn) >= 0) {
+			fprintf(fp, "\tR[%d] = %s(parser);\n", d, QUOTE_VARS[quoteVar(ins->fn)].name);
+			return 0;
+		}
+		fprintf(fp, "\tR[%d] = F%d(parser, 0, 0, 0);\n", d, fn);
+		return 0;
+	case OP_CALL:
+		genArgs(g, ins);
+		fprintf(fp, "\tR[%d] = F%d(parser, %d, argv, R[%d]);\n", d, fn, ins->b, d);
+		return 0;
+	case OP_ADD: fprintf(fp, "\tR[%d] = ADD(R[%d], R[%d], R[%d]);\n", d, ins->a, ins->b, d); return 0;
+	case OP_SUB: fprintf(fp, "\tR[%d] = SUB(R[%d], R[%d], R[%d]);\n", d, ins->a, ins->b, d); return 0;
+	case OP_MUL: fprintf(fp, "\tR[%d] = MUL(R[%d], R[%d], R[%d]);\n", d, ins->a, ins->b, d); return 0;
+	case OP_DIV: fprintf(fp, "\tR[%d] = DIV(R[%d], R[%d], R[%d]);\n", d, ins->a, ins->b, d); return 0;
+	case OP_ARITH_AA:
+		fprintf(fp, "\tif (R[%d]->size && R[%d]->size)\n\t\tR[%d] = suanShuYunSuan_AA(R[%d], R[%d], '%c', R[%d]);\n",
+			ins->a, ins->b, d, ins->a, ins->b, (char)ins->n, d);
+		return 0;
+	case OP_ARITH_AN:
+		fprintf(fp, "\tif (R[%d]->size)\n\t\tR[%d] = suanShuYunSuan_AN(R[%d], ", ins->a, d, ins->a);
+		genDouble(fp, ins->f);
+		fprintf(fp, ", '%c', R[%d]);\n", (char)ins->n, d);
+		return 0;
+	case OP_ARITH_NA:
+		fprintf(fp, "\tif (R[%d]->size)\n\t\tR[%d] = suanShuYunSuan_NA(", ins->a, d);
+		genDouble(fp, ins->f);
+		fprintf(fp, ", R[%d], '%c', R[%d]);\n", ins->a, (char)ins->n, d);
+		return 0;
+	case OP_REF: fprintf(fp, "\tR[%d] = REF(R[%d], %d, R[%d]);\n", d, ins->a, ins->n, d); return 0;
+	case OP_MAX:
+		fprintf(fp, "\tR[%d] = MAX(R[%d], ", d, ins->a);
+		genDouble(fp, ins->f);
+		fprintf(fp, ", R[%d]);\n", d);
+		return 0;
+	case OP_ABS: fprintf(fp, "\tR[%d] = ABS(R[%d], R[%d]);\n", d, ins->a, d); return 0;
+	case OP_HHV: fprintf(fp, "\tR[%d] = HHV(R[%d], %d, R[%d]);\n", d, ins->a, ins->n, d); return 0;
+	case OP_LLV: fprintf(fp, "\tR[%d] = LLV(R[%d], %d, R[%d]);\n", d, ins->a, ins->n, d); return 0;
+	case OP_MA: fprintf(fp, "\tR[%d] = MA(R[%d], %d, R[%d]);\n", d, ins->a, ins->n, d); return 0;
+	case OP_EMA: fprintf(fp, "\tR[%d] = EMA(R[%d], %d, R[%d]);\n", d, ins->a, ins->n, d); return 0;
+	case OP_SMA: fprintf(fp, "\tR[%d] = SMA(R[%d], %d, %d, R[%d]);\n", d, ins->a, ins->n, ins->m, d); return 0;
+	case OP_RSI:
+		fprintf(fp, "\tR[%d] = idiomRSI(R[%d], %d, %d, ", d, args[0], ins->n, ins->m);
+		genDouble(fp, ins->f);
+		fprintf(fp, ", &R[%d], &R[%d], R[%d]);\n", args[1], args[2], d);
+		return 0;
+	case OP_RSV:
+		fprintf(fp, "\tR[%d] = idiomRSV(R[%d], R[%d], R[%d], %d, ", d, args[0], args[1], args[2], ins->n);
+		genDouble(fp, ins->f);
+		fprintf(fp, ", R[%d]);\n", d);
+		return 0;
+	case OP_DIF:
+		fprintf(fp, "\tR[%d] = idiomDIF(R[%d], %d, %d, &R[%d], &R[%d], R[%d]);\n",
+			d, args[0], ins->n, ins->m, args[1], args[2], d);
+		return 0;
+	case OP_FLOAT32:
+		fprintf(fp, "\tif (R[%d]) {\n\t\tR[%d] = FLOAT32(R[%d], R[%d]);\n", ins->a, d, ins->a, d);
+		if (ins->n)
+			fprintf(fp, "\t\tvalueTrim(R[%d], FLOAT_SOURCE_KEEP);\n", ins->a);
+		fprintf(fp, "\t}\n");
+		return 0;
+	case OP_FUSED:
+		genArgs(g, ins);
+		fprintf(fp, "\tR[%d] = fusedRun(&FE%d, argv, loop%d, R[%d]);\n", d, ins->n, ins->n, d);
+		return 0;
+	default:
+		/* JITָֻʱ */
+		return -1;
+	}
+}
+
+/* create */
+static void genConst(CodeGen *g, int reg)
+{
+	const Value *v = g->prog->regs[reg];
+	FILE *fp = g->fp;
+	if (v->type == VT_INT) {
+		fprintf(fp, "\tif (!(R[%d] = valueNew(VT_INT)))\n\t\tgoto fail;\n", reg);
+		fprintf(fp, "\tR[%d]->i = %d;\n", reg, v->i);
+	} else {
+		fprintf(fp, "\tif (!(R[%d] = valueNew(VT_DOUBLE)))\n\t\tgoto fail;\n", reg);
+		fprintf(fp, "\tR[%d]->f = ", reg);
+		genDouble(fp, v->f);
+		fprintf(fp, ";\n");
+	}
+}
+
+static int genProgram(CodeGen *g, Parser *p, const char *name)
+{
+	FILE *fp = g->fp;
+	Program *prog = g->prog;
+	Stmt **stmts = (Stmt **)p->ast->stmts.data;
+	int nregs = prog->nregs > 0 ? prog->nregs : 1;
+	int maxArgc = prog->maxArgc > 0 ? prog->maxArgc : 1;
+
+	if (g->builtin)
+		fprintf(fp, "/* parserGenerateBuiltin, Ҫ޸. ޸Ĺʽinterp builtin */\n\n");
+	else
+		fprintf(fp, "/* parserGenerateCpp, Ҫ޸ */\n\n");
+	fprintf(fp, "#include <math.h>\n#include <stdlib.h>\n\n#include <limits>\n\n");
+	fprintf(fp, "#include \"indicators.h\"\n#include \"plugin.h\"\n#include \"vm.h\"\n\n");
+	fprintf(fp, "#ifndef NAN\n#define NAN (std::numeric_limits<double>::quiet_NaN())\n#endif\n\n");
+	fprintf(fp, "using namespace tg;\n\nnamespace {\n\n");
+
+	fprintf(fp, "struct State {\n\tValue *R[%d];\n\tunsigned int seen[%d];\n};\n\n",
+		nregs, prog->instrs.size > 0 ? prog->instrs.size : 1);
+
+	/* ֵͨõıͺ */
+	g->nfns = 0;
+	int *fns = (int *)malloc(sizeof(int) * (prog->instrs.size > 0 ? prog->instrs.size : 1));
+	if (!fns)
+		return -1;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		const Instr *ins = (const Instr *)arrayGet(&prog->instrs, i);
+		fns[i] = -1;
+		if ((ins->op != OP_VAR && ins->op != OP_CALL) || (ins->op == OP_VAR && quoteVar(ins->fn) >= 0))
+			continue;
+		const char *fname = ins->op == OP_VAR ? findVariableName(ins->fn) : findFunctionName(ins->fn);
+		if (!fname) {
+			warn("C++ʱҲ%p\n", ins->fn);
+			free(fns);
+			return -1;
+		}
+		fns[i] = g->nfns++;
+		fprintf(fp, "static ValueFn F%d; /* %s */\n", fns[i], fname);
+	}
+	if (g->nfns)
+		fprintf(fp, "\n");
+
+	for (int k = 0; k < prog->fused.size; ++k) {
+		if (genFusedLoop(g, k)) {
+			free(fns);
+			return -1;
+		}
+	}
+
+	fprintf(fp, "static const char *const STMT_NAMES[] = {\n");
+	for (int i = 0; i < p->ast->stmts.size; ++i) {
+		fprintf(fp, "\t");
+		genString(fp, stmts[i]->id.data);
+		fprintf(fp, ",\n");
+	}
+	fprintf(fp, "\t0\n};\n\n");
+
+	fprintf(fp, "static const int STMT_REGS[] = {");
+	for (int i = 0; i < prog->nstmts; ++i) {
+		fprintf(fp, "%s %d", i ? "," : "", prog->stmtRegs[i]);
+	}
+	fprintf(fp, "%s -1 };\n\n", prog->nstmts ? "," : "");
+
+	/* ͷ */
+	fprintf(fp, "static void destroy(void *state)\n{\n\tif (!state)\n\t\treturn;\n");
+	fprintf(fp, "\tValue **R = ((State *)state)->R;\n");
+	for (int i = 0; i < prog->nregs; ++i) {
+		if (prog->regFlags[i] & RF_OWN)
+			fprintf(fp, "\tvalueFree(R[%d]);\n", i);
+	}
+	fprintf(fp, "\tfree(state);\n}\n\n");
+
+	/* , Һɳ */
+	fprintf(fp, "static void *create()\n{\n");
+	fprintf(fp, "\tState *state = (State *)calloc(1, sizeof(State));\n\tif (!state)\n\t\treturn 0;\n");
+	fprintf(fp, "\tValue **R = state->R;\n");
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		const Instr *ins = (const Instr *)arrayGet(&prog->instrs, i);
+		if (fns[i] < 0)
+			continue;
+		bool var = ins->op == OP_VAR;
+		fprintf(fp, "\tif (!(F%d = %s(", fns[i], var ? "findVariable" : "findFunction");
+		genString(fp, var ? findVariableName(ins->fn) : findFunctionName(ins->fn));
+		fprintf(fp, ")))\n\t\tgoto fail;\n");
+	}
+	for (int i = 0; i < prog->nregs; ++i) {
+		if ((prog->regFlags[i] & RF_CONST) && prog->regs[i])
+			genConst(g, i);
+	}
+	fprintf(fp, "\t(void)R;\n\treturn state;\nfail:\n\tdestroy(state);\n\treturn 0;\n}\n\n");
+
+	/*  */
+	fprintf(fp, "static int run(void *state, void *parser)\n{\n");
+	fprintf(fp, "\tValue **R = ((State *)state)->R;\n");
+	fprintf(fp, "\tunsigned int *seen = ((State *)state)->seen, sum;\n");
+	fprintf(fp, "\tconst Value *argv[%d];\n\t(void)argv;\n\t(void)parser;\n\t(void)seen;\n\t(void)sum;\n", maxArgc);
+	int ret = 0;
+	for (int i = 0; i < prog->instrs.size && !ret; ++i) {
+		const Instr *ins = (const Instr *)arrayGet(&prog->instrs, i);
+		if (ins->op != OP_VAR && (ins->op != OP_CALL || ins->n))
+			genSkip(g, ins, i);
+		ret = genInstr(g, ins, fns[i]);
+		if (ins->op != OP_VAR)
+			fprintf(fp, "\tif (R[%d])\n\t\tR[%d]->version++;\nL%d:\n", ins->dst, ins->dst, i);
+	}
+	free(fns);
+	if (ret)
+		return -1;
+	fprintf(fp, "\treturn 0;\n}\n\n");
+
+	fprintf(fp, "static Value *stmtValue(void *state, int i)\n{\n");
+	fprintf(fp, "\tif (i < 0 || i >= %d)\n\t\treturn 0;\n", prog->nstmts);
+	fprintf(fp, "\treturn ((State *)state)->R[STMT_REGS[i]];\n}\n\n");
+
+	fprintf(fp, "static const FormulaPlugin PLUGIN = {\n");
+	fprintf(fp, "\tPLUGIN_VERSION,\n\t");
+	genString(fp, name);
+	fprintf(fp, ",\n\t%uu,\n\t%d,\n\tSTMT_NAMES,\n", programFingerprint(prog), prog->nstmts);
+	fprintf(fp, "\tcreate,\n\tdestroy,\n\trun,\n\tstmtValue,\n\t%d,\n};\n\n", programLookback(prog));
+	fprintf(fp, "}\n\n");
+
+	if (g->builtin) {
+		fprintf(fp, "namespace tg {\n\nconst FormulaPlugin *builtinFormula_%s()\n{\n\treturn &PLUGIN;\n}\n\n}\n", name);
+	} else {
+		fprintf(fp, "extern \"C\"\n#ifdef _WIN32\n__declspec(dllexport)\n#endif\n");
+		fprintf(fp, "const FormulaPlugin *tgFormulaPlugin()\n{\n\treturn &PLUGIN;\n}\n");
+	}
+	return ferror(fp) ? -1 : 0;
+}
+
+/* ùʽǺһ */
+static bool isIdentifier(const char *name)
+{
+	if (!*name)
+		return false;
+	for (const char *s = name; *s; ++s) {
+		if (!(*s == '_' || (*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z')
+				|| (s != name && *s >= '0' && *s <= '9')))
+			return false;
+	}
+	return true;
+}
+
+static int generate(Parser *yacc, const char *name, const char *filename, bool builtin)
+{
+	if (!yacc || !yacc->ast || !name || !filename)
+		return -1;
+	if (builtin && !isIdentifier(name))
+		return -1;
+	/* ʹp->prog, IM_JITʱʱɵָ */
+	Program *prog = programCompile(yacc);
+	if (!prog)
+		return -1;
+	FILE *fp = fopen(filename, "w");
+	if (!fp) {
+		warn("ļ%sʧ\n", filename);
+		programFree(prog);
+		return -1;
+	}
+	CodeGen g;
+	g.fp = fp;
+	g.prog = prog;
+	g.nfns = 0;
+	g.builtin = builtin;
+	int ret = genProgram(&g, yacc, name);
+	if (fclose(fp))
+		ret = -1;
+	programFree(prog);
+	if (ret)
+		warn("C++%sʧ\n", filename);
+	return ret;
+}
+
+int parserGenerateCpp(void *p, const char *name, const char *filename)
+{
+	return generate((Parser *)p, name, filename, false);
+}
+
+int parserGenerateBuiltin(void *p, const char *name, const char *filename)
+{
+	return generate((Parser *)p, name, filename, true);
+}
+
+/* ------ C++ ------ */
+
+}
@@ -0,0 +1,104 @@
+#include "formula-set.h"
+
+#include <assert.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+#include "parser-impl.h"
+#include "vm.h"
+
+namespace tg {
+
+struct FormulaSet {
+	Array parsers; /* Parser * */
+	Program *prog; /* йʽϲֽ, ¹ʽ± */
+	void *ctx; /* ʱñparser, ֻuserdata */
+};
+
+void *formulaSetNew()
+{
+	FormulaSet *s = (FormulaSet *)malloc(sizeof(*s));
+	if (!s)
+		return 0;
+	if (arrayInit(&s->parsers, sizeof(Parser *), 8)) {
+		free(s);
+		return 0;
+	}
+	s->prog = 0;
+	s->ctx = parserNew(0, 0);
+	if (!s->ctx) {
+		arrayFree(&s->parsers);
+		free(s);
+		return 0;
+	}
+	return s;
+}
+
+void formulaSetFree(void *s)
+{
+	FormulaSet *fs = (FormulaSet *)s;
+	if (!fs)
+		return;
+	programFree(fs->prog);
+	parserFree(fs->ctx);
+	arrayFree(&fs->parsers);
+	free(fs);
+}
+
+int formulaSetAdd(void *s, void *parser)
+{
+	FormulaSet *fs = (FormulaSet *)s;
+	Parser *p = (Parser *)parser;
+	if (!fs || !p || !p->ast)
+		return -1;
+	Parser **pp = (Parser **)arrayAdd(&fs->parsers);
+	if (!pp)
+		return -1;
+	*pp = p;
+	if (fs->prog) {
+		programFree(fs->prog);
+		fs->prog = 0;
+	}
+	return 0;
+}
+
+int formulaSetInterp(void *s, void *userdata)
+{
+	FormulaSet *fs = (FormulaSet *)s;
+	if (!fs)
+		return -1;
+	if (!fs->prog) {
+		fs->prog = programCompileSet((Parser **)fs->parsers.data, fs->parsers.size);
+		if (!fs->prog)
+			return -1;
+	}
+	Parser *ctx = (Parser *)fs->ctx;
+	ctx->userdata = userdata;
+	return programRun(fs->prog, ctx);
+}
+
+int formulaSetGetIndicator(void *s, void *parser, const char *name, double *outf)
+{
+	FormulaSet *fs = (FormulaSet *)s;
+	Value *v = 0;
+	if (fs && fs->prog) {
+		/* ʽStmt */
+		int base = 0;
+		for (int k = 0; k < fs->parsers.size; ++k) {
+			Parser *p = *(Parser **)arrayGet(&fs->parsers, k);
+			if (p == parser) {
+				int i = parserFindStmt(p, name);
+				if (i >= 0)
+					v = programStmtValue(fs->prog, base + i);
+				break;
+			}
+			base += p->ast->stmts.size;
+		}
+	}
+	return valueToIndicator(v, outf);
+}
+
+}
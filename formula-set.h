@@ -0,0 +1,27 @@
+#ifndef TG_INDICATOR_FORMULA_SET_H
+#define TG_INDICATOR_FORMULA_SET_H
+
+namespace tg {
+
+/* ------ FormulaSetʼ ------ */
+
+/* ͬһƷеĶʽϲһDAG, ͬʽнṹͬӱʽ
+ * (EMA(CLOSE,12))ÿֻһ. parserѾɹ,
+ * FormulaSetͷ֮ǰͷ */
+void *formulaSetNew();
+void formulaSetFree(void *s);
+
+/* һʽ, ɹ0 */
+int formulaSetAdd(void *s, void *parser);
+
+/* һʱ(¹ʽ)йʽ뵽һ */
+int formulaSetInterp(void *s, void *userdata);
+
+/* ȡʽparserΪnameֵָ */
+int formulaSetGetIndicator(void *s, void *parser, const char *name, double *outf);
+
+/* ------ FormulaSet ------ */
+
+}
+
+#endif
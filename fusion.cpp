@@ -0,0 +1,316 @@
+#include "vm.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include <limits>
+
+#include "base.h"
+#include "indicators.h"
+
+namespace tg {
+
+/* VC ûNAN ? */
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+/* ------ ںпʼ ------ */
+
+/* ÿμԪظ, мջ, L1 */
+#define FUSED_BLOCK 256
+
+/* suanShuYunSuan_AAһ, ĺ,
+ * ĴСΪСĴС, ϴεıſʼ */
+Value *fusedRun(const FusedExpr *fe, const Value **inputs, FusedLoopFn loop, Value *R)
+{
+	assert(fe && fe->ninputs > 0);
+	int rsize = -1;
+	for (int j = 0; j < fe->ninputs; ++j) {
+		const Value *X = inputs[j];
+		if (!X)
+			return R;
+		int size = X->size - fe->shifts[j];
+		if (size <= 0)
+			return R;
+		if (rsize < 0 || size < rsize)
+			rsize = size;
+	}
+	if (!R) {
+		R = valueNew(VT_ARRAY_DOUBLE);
+		if (!R)
+			return 0;
+	}
+	int64_t no = inputs[0]->no - fe->shifts[0];
+	if (!valueResize(R, rsize, no)) {
+		valueFree(R);
+		return 0;
+	}
+
+	/* jriԪضӦbase[j][ri] */
+	const double *base[MAX_FUSED_INPUTS];
+	for (int j = 0; j < fe->ninputs; ++j) {
+		base[j] = inputs[j]->fs + (inputs[j]->size - fe->shifts[j] - rsize);
+	}
+	int count = R->no ? (int)(no - R->no + 1) : rsize;
+	if (count > rsize)
+		count = rsize;
+	int roff = rsize - R->size; /* RֻĽʱ(valueTrim)ǰٵԪ */
+
+	if (loop) {
+		int b = rsize - count;
+		const double *shifted[MAX_FUSED_INPUTS];
+		for (int j = 0; j < fe->ninputs; ++j) {
+			shifted[j] = base[j] + b;
+		}
+		if (count > 0)
+			loop(shifted, R->fs + b - roff, count);
+		R->no = no;
+		return R;
+	}
+
+	double stack[MAX_FUSED_DEPTH][FUSED_BLOCK];
+	for (int b = rsize - count; b < rsize; b += FUSED_BLOCK) {
+		int n = rsize - b < FUSED_BLOCK ? rsize - b : FUSED_BLOCK;
+		int sp = 0;
+		for (int k = 0; k < fe->ncode; ++k) {
+			const FusedCode *c = &fe->code[k];
+			double *x = sp > 0 ? stack[sp - 1] : 0;
+			double *y = x;
+			if (c->op >= FC_ADD && c->op <= FC_DIV) {
+				x = stack[sp - 2];
+				--sp;
+			}
+			switch (c->op) {
+			case FC_LOAD: {
+				const double *src = base[c->input] + b;
+				double *dst = stack[sp++];
+				for (int i = 0; i < n; ++i)
+					dst[i] = src[i];
+				break;
+			}
+			case FC_CONST: {
+				double *dst = stack[sp++];
+				for (int i = 0; i < n; ++i)
+					dst[i] = c->f;
+				break;
+			}
+			case FC_ADD:
+				for (int i = 0; i < n; ++i)
+					x[i] = x[i] + y[i];
+				break;
+			case FC_SUB:
+				for (int i = 0; i < n; ++i)
+					x[i] = x[i] - y[i];
+				break;
+			case FC_MUL:
+				for (int i = 0; i < n; ++i)
+					x[i] = x[i] * y[i];
+				break;
+			case FC_DIV:
+				for (int i = 0; i < n; ++i)
+					x[i] = y[i] != 0 ? x[i] / y[i] : NAN;
+				break;
+			case FC_MAX:
+				for (int i = 0; i < n; ++i)
+					x[i] = x[i] > c->f ? x[i] : c->f;
+				break;
+			case FC_ABS:
+				for (int i = 0; i < n; ++i)
+					x[i] = fabs(x[i]);
+				break;
+			}
+		}
+		assert(sp == 1);
+		memcpy(R->fs + b - roff, stack[0], sizeof(double) * n);
+	}
+	R->no = no;
+	return R;
+}
+
+/* ------ ںн ------ */
+
+/* ------ ںϱ뿪ʼ ------ */
+
+struct Fuser {
+	Program *prog;
+	UseDef ud;
+	FusedExpr fe;
+	int inputs[MAX_FUSED_INPUTS]; /* ڵļĴ */
+	int depth, maxDepth;
+	int nops; /* ںϵ, REF */
+};
+
+static bool isElementwise(enum OpCode op)
+{
+	switch (op) {
+	case OP_ARITH_AA:
+	case OP_ARITH_AN:
+	case OP_ARITH_NA:
+	case OP_MAX:
+	case OP_ABS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* ֻһԪʹ, Ҫ */
+static bool isInternal(Fuser *f, int reg)
+{
+	const Instr *ins = useDefInstr(&f->ud, f->prog, reg);
+	if (!ins || !isElementwise(ins->op))
+		return false;
+	if (!useDefIsTemp(&f->ud, f->prog, reg, 1))
+		return false;
+	const Instr *u = (const Instr *)arrayGet(&f->prog->instrs, f->ud.user[reg]);
+	return isElementwise(u->op);
+}
+
+static int pushCode(Fuser *f, enum FusedOpCode op, int input, double fv)
+{
+	if (f->fe.ncode >= MAX_FUSED_CODE)
+		return -1;
+	FusedCode *c = &f->fe.code[f->fe.ncode++];
+	c->op = op;
+	c->input = input;
+	c->f = fv;
+	if (op == FC_LOAD || op == FC_CONST) {
+		if (++f->depth > f->maxDepth)
+			f->maxDepth = f->depth;
+	} else if (op >= FC_ADD && op <= FC_DIV) {
+		--f->depth;
+	}
+	return f->maxDepth > MAX_FUSED_DEPTH ? -1 : 0;
+}
+
+static int fuseInstr(Fuser *f, const Instr *ins, int shift);
+
+/* REFֻıλ, ֱӴ */
+static int fuseOperand(Fuser *f, int reg, int shift)
+{
+	const Instr *ins = useDefInstr(&f->ud, f->prog, reg);
+	while (ins && ins->op == OP_REF) {
+		shift += ins->n;
+		reg = ins->a;
+		ins = useDefInstr(&f->ud, f->prog, reg);
+	}
+	if (isInternal(f, reg))
+		return fuseInstr(f, ins, shift);
+
+	int j;
+	for (j = 0; j < f->fe.ninputs; ++j) {
+		if (f->inputs[j] == reg && f->fe.shifts[j] == shift)
+			break;
+	}
+	if (j == f->fe.ninputs) {
+		if (j >= MAX_FUSED_INPUTS)
+			return -1;
+		f->inputs[j] = reg;
+		f->fe.shifts[j] = shift;
+		f->fe.ninputs++;
+	}
+	return pushCode(f, FC_LOAD, j, 0);
+}
+
+static enum FusedOpCode arithCode(int op)
+{
+	switch (op) {
+	case '+': return FC_ADD;
+	case '-': return FC_SUB;
+	case '*': return FC_MUL;
+	default: return FC_DIV;
+	}
+}
+
+static int fuseInstr(Fuser *f, const Instr *ins, int shift)
+{
+	f->nops++;
+	switch (ins->op) {
+	case OP_ARITH_AA:
+		if (fuseOperand(f, ins->a, shift) || fuseOperand(f, ins->b, shift))
+			return -1;
+		return pushCode(f, arithCode(ins->n), 0, 0);
+	case OP_ARITH_AN:
+		if (fuseOperand(f, ins->a, shift) || pushCode(f, FC_CONST, 0, ins->f))
+			return -1;
+		return pushCode(f, arithCode(ins->n), 0, 0);
+	case OP_ARITH_NA:
+		if (pushCode(f, FC_CONST, 0, ins->f) || fuseOperand(f, ins->a, shift))
+			return -1;
+		return pushCode(f, arithCode(ins->n), 0, 0);
+	case OP_MAX:
+		if (fuseOperand(f, ins->a, shift))
+			return -1;
+		return pushCode(f, FC_MAX, 0, ins->f);
+	case OP_ABS:
+		if (fuseOperand(f, ins->a, shift))
+			return -1;
+		return pushCode(f, FC_ABS, 0, 0);
+	default:
+		assert(0);
+		return -1;
+	}
+}
+
+int programFuse(Program *prog)
+{
+	Fuser f;
+	f.prog = prog;
+	if (useDefInit(&f.ud, prog))
+		return -1;
+
+	int ngroups = 0;
+	int ret = 0;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		Instr *ins = (Instr *)arrayGet(&prog->instrs, i);
+		if (!isElementwise(ins->op) || isInternal(&f, ins->dst))
+			continue;
+		memset(&f.fe, 0, sizeof(f.fe));
+		f.depth = f.maxDepth = 0;
+		f.nops = 0;
+		/* ʱһ鲻ں */
+		if (fuseInstr(&f, ins, 0) || f.nops < 2)
+			continue;
+
+		int offset = prog->operands.size;
+		for (int j = 0; j < f.fe.ninputs; ++j) {
+			int *r = (int *)arrayAdd(&prog->operands);
+			if (!r) {
+				ret = -1;
+				break;
+			}
+			*r = f.inputs[j];
+		}
+		FusedExpr *fe = ret ? 0 : (FusedExpr *)arrayAdd(&prog->fused);
+		if (!fe) {
+			ret = -1;
+			break;
+		}
+		*fe = f.fe;
+		ins->op = OP_FUSED;
+		ins->a = offset;
+		ins->b = f.fe.ninputs;
+		ins->n = prog->fused.size - 1;
+		ins->m = 0;
+		ins->f = 0;
+		ins->fn = 0;
+		if (f.fe.ninputs > prog->maxArgc)
+			prog->maxArgc = f.fe.ninputs;
+		ngroups++;
+	}
+	useDefFree(&f.ud);
+	if (ret)
+		return ret;
+	if (ngroups > 0) {
+		debug("ں%dԪ\n", ngroups);
+		/* ںϵָĽٱȡ */
+		return programRemoveDead(prog);
+	}
+	return 0;
+}
+
+/* ------ ںϱ ------ */
+
+}
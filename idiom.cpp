@@ -0,0 +1,383 @@
+#include "vm.h"
+
+#include <assert.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+
+#include "base.h"
+#include "indicators.h"
+
+namespace tg {
+
+/* VC ûNAN ? */
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+/* ------ ָ㿪ʼ ------ */
+
+/* suanShuYunSuan_AAĳһ */
+static inline double safeDiv(double x, double y)
+{
+	return y != 0 ? x / y : NAN;
+}
+
+/* ׼õõ״̬, Сͱһ */
+static bool prepareState(Value **S, int rsize, int64_t no)
+{
+	if (!*S) {
+		*S = valueNew(VT_ARRAY_DOUBLE);
+		if (!*S)
+			return false;
+	}
+	return valueResize(*S, rsize, no);
+}
+
+/* ϴεıſʼҪĸ */
+static inline int countFrom(const Value *R, int64_t no, int rsize)
+{
+	int count = R->no ? (int)(no - R->no + 1) : rsize;
+	return count > rsize ? rsize : count;
+}
+
+/* RSI:SMA(MAX(X,0),N,M)/SMA(ABS(X),N,M)*K */
+Value *idiomRSI(const Value *X, int N, int M, double K, Value **SA, Value **SB, Value *R)
+{
+	assert(N > 0 && M >= 0);
+	if (!X || X->size == 0)
+		return R;
+	int rsize = X->size;
+	if (!prepareState(SA, rsize, X->no) || !prepareState(SB, rsize, X->no))
+		return R;
+	if (!R) {
+		R = valueNew(VT_ARRAY_DOUBLE);
+		if (!R)
+			return 0;
+	}
+	if (!valueResize(R, rsize, X->no)) {
+		valueFree(R);
+		return 0;
+	}
+
+	double *sa = (*SA)->fs;
+	double *sb = (*SB)->fs;
+	int roff = rsize - R->size; /* RֻĽʱ(valueTrim)ǰٵԪ */
+	int ri = rsize - countFrom(R, X->no, rsize);
+	double ya = ri > 0 ? sa[ri-1] : 0;
+	double yb = ri > 0 ? sb[ri-1] : 0;
+	for (; ri < rsize; ++ri) {
+		double x = X->fs[ri];
+		double a = x > 0 ? x : 0;
+		double b = fabs(x);
+		if (ri > 0) { /* SMAһ */
+			a = (a * M + ya * (N - M)) / N;
+			b = (b * M + yb * (N - M)) / N;
+		}
+		sa[ri] = ya = a;
+		sb[ri] = yb = b;
+		R->fs[ri - roff] = safeDiv(a, b) * K;
+	}
+	(*SA)->no = (*SB)->no = R->no = X->no;
+	return R;
+}
+
+/* ÿμĴֵĸ, ջ */
+#define RSV_BLOCK 256
+
+/* RSV:(C-LLV(L,N))/(HHV(H,N)-LLV(L,N))*K
+ * HHVLLVĵηR->state */
+Value *idiomRSV(const Value *C, const Value *H, const Value *L, int N, double K, Value *R)
+{
+	assert(N > 0);
+	if (!C || !H || !L || C->size == 0 || H->size == 0 || L->size == 0)
+		return R;
+	if (N <= 0 || H->size < N || L->size < N)
+		return R;
+	/* Ӻ */
+	int rsize = C->size;
+	if (H->size - N + 1 < rsize)
+		rsize = H->size - N + 1;
+	if (L->size - N + 1 < rsize)
+		rsize = L->size - N + 1;
+	if (!R) {
+		R = valueNew(VT_ARRAY_DOUBLE);
+		if (!R)
+			return 0;
+	}
+	if (!valueResize(R, rsize, C->no)) {
+		valueFree(R);
+		return 0;
+	}
+
+	int stsize = extremeStateSize(N);
+	ExtremeState *hst = (ExtremeState *)R->state;
+	if (!hst || hst->N != N) {
+		free(hst);
+		hst = (ExtremeState *)malloc(stsize * 2);
+		R->state = hst;
+		if (!hst) {
+			valueFree(R);
+			return 0;
+		}
+		extremeStateInit(hst, N);
+		extremeStateInit((ExtremeState *)((char *)hst + stsize), N);
+	}
+	ExtremeState *lst = (ExtremeState *)((char *)hst + stsize);
+	if (!R->no)
+		hst->no = lst->no = 0;
+
+	const double *c = C->fs + C->size - rsize;
+	int roff = rsize - R->size; /* RֻĽʱ(valueTrim)ǰٵԪ */
+	double hh[RSV_BLOCK], ll[RSV_BLOCK];
+	for (int ri = rsize - countFrom(R, C->no, rsize); ri < rsize; ri += RSV_BLOCK) {
+		int n = rsize - ri < RSV_BLOCK ? rsize - ri : RSV_BLOCK;
+		/* ĵriԪضӦı */
+		int64_t hno = H->no - (rsize - 1 - ri);
+		int64_t lno = L->no - (rsize - 1 - ri);
+		windowExtreme(H, N, true, hno, hno + n - 1, hst, hh);
+		windowExtreme(L, N, false, lno, lno + n - 1, lst, ll);
+		for (int j = 0; j < n; ++j) {
+			R->fs[ri + j - roff] = safeDiv(c[ri + j] - ll[j], hh[j] - ll[j]) * K;
+		}
+	}
+	R->no = C->no;
+	return R;
+}
+
+/* DIF:EMA(X,S)-EMA(X,L) */
+Value *idiomDIF(const Value *X, int S, int L, Value **E1, Value **E2, Value *R)
+{
+	assert(S >= 0 && L >= 0);
+	if (!X || X->size == 0)
+		return R;
+	int rsize = X->size;
+	if (!prepareState(E1, rsize, X->no) || !prepareState(E2, rsize, X->no))
+		return R;
+	if (!R) {
+		R = valueNew(VT_ARRAY_DOUBLE);
+		if (!R)
+			return 0;
+	}
+	if (!valueResize(R, rsize, X->no)) {
+		valueFree(R);
+		return 0;
+	}
+
+	double *e1 = (*E1)->fs;
+	double *e2 = (*E2)->fs;
+	int roff = rsize - R->size; /* RֻĽʱ(valueTrim)ǰٵԪ */
+	int ri = rsize - countFrom(R, X->no, rsize);
+	double y1 = ri > 0 ? e1[ri-1] : 0;
+	double y2 = ri > 0 ? e2[ri-1] : 0;
+	for (; ri < rsize; ++ri) {
+		double a = X->fs[ri];
+		double b = a;
+		if (ri > 0) { /* EMAһ */
+			a = (a * 2.0 + y1 * (S - 1)) / (S + 1);
+			b = (b * 2.0 + y2 * (L - 1)) / (L + 1);
+		}
+		e1[ri] = y1 = a;
+		e2[ri] = y2 = b;
+		R->fs[ri - roff] = a - b;
+	}
+	(*E1)->no = (*E2)->no = R->no = X->no;
+	return R;
+}
+
+/* ------ ָ ------ */
+
+/* ------ ָʶʼ ------ */
+
+struct Matcher {
+	Program *prog;
+	UseDef ud;
+	unsigned char *removed; /* ״ָ̬ */
+	int nmatched;
+};
+
+/* regop */
+static Instr *matchOp(Matcher *mt, int reg, enum OpCode op)
+{
+	Instr *ins = useDefInstr(&mt->ud, mt->prog, reg);
+	if (!ins || ins->op != op)
+		return 0;
+	return ins;
+}
+
+/* regֻʹһεм, op */
+static Instr *matchTemp(Matcher *mt, int reg, enum OpCode op)
+{
+	if (!useDefIsTemp(&mt->ud, mt->prog, reg, 1))
+		return 0;
+	return matchOp(mt, reg, op);
+}
+
+/* ָĽָΪ״̬, ԭָҪɾ */
+static void removeInstr(Matcher *mt, const Instr *ins)
+{
+	mt->removed[mt->ud.def[ins->dst]] = 1;
+}
+
+/* 滹һ, һ */
+static Instr *matchScale(Matcher *mt, Instr *ins, double *k)
+{
+	if (useDefIsTemp(&mt->ud, mt->prog, ins->dst, 1)) {
+		Instr *u = (Instr *)arrayGet(&mt->prog->instrs, mt->ud.user[ins->dst]);
+		if (u->op == OP_ARITH_AN && u->n == '*' && u->a == ins->dst) {
+			*k = u->f;
+			return u;
+		}
+	}
+	*k = 1;
+	return ins;
+}
+
+/* 滻µָ, argsΪ״̬Ĵ */
+static int replaceInstr(Matcher *mt, Instr *ins, enum OpCode op, const int *args, int nargs)
+{
+	int offset = mt->prog->operands.size;
+	for (int j = 0; j < nargs; ++j) {
+		int *r = (int *)arrayAdd(&mt->prog->operands);
+		if (!r)
+			return -1;
+		*r = args[j];
+	}
+	if (nargs > mt->prog->maxArgc)
+		mt->prog->maxArgc = nargs;
+	ins->op = op;
+	ins->a = offset;
+	ins->b = nargs;
+	ins->fn = 0;
+	mt->nmatched++;
+	return 0;
+}
+
+/* SMA(MAX(X,0),N,M)/SMA(ABS(X),N,M)
+ * MAX,ABSָ¼, طʹʱԭָ */
+static int matchRSI(Matcher *mt, Instr *ins)
+{
+	if (ins->op != OP_ARITH_AA || ins->n != '/')
+		return 0;
+	Instr *sa = matchTemp(mt, ins->a, OP_SMA);
+	Instr *sb = matchTemp(mt, ins->b, OP_SMA);
+	if (!sa || !sb || sa->n != sb->n || sa->m != sb->m || sa->n <= 0 || sa->m < 0)
+		return 0;
+	Instr *a = matchOp(mt, sa->a, OP_MAX);
+	Instr *b = matchOp(mt, sb->a, OP_ABS);
+	if (!a || !b || a->f != 0 || a->a != b->a)
+		return 0;
+
+	int args[3] = { a->a, sa->dst, sb->dst };
+	int n = sa->n, m = sa->m;
+	removeInstr(mt, sa);
+	removeInstr(mt, sb);
+	double k;
+	Instr *root = matchScale(mt, ins, &k);
+	if (replaceInstr(mt, root, OP_RSI, args, 3))
+		return -1;
+	root->n = n;
+	root->m = m;
+	root->f = k;
+	return 0;
+}
+
+/* (C-LLV(L,N))/(HHV(H,N)-LLV(L,N)), ӱʽLLVͬһĴ */
+static int matchRSV(Matcher *mt, Instr *ins)
+{
+	if (ins->op != OP_ARITH_AA || ins->n != '/')
+		return 0;
+	Instr *num = matchTemp(mt, ins->a, OP_ARITH_AA);
+	Instr *den = matchTemp(mt, ins->b, OP_ARITH_AA);
+	if (!num || !den || num->n != '-' || den->n != '-' || num->b != den->b)
+		return 0;
+	Instr *ll = matchOp(mt, num->b, OP_LLV);
+	Instr *hh = matchOp(mt, den->a, OP_HHV);
+	if (!ll || !hh || ll->n != hh->n || ll->n <= 0)
+		return 0;
+
+	int args[3] = { num->a, hh->a, ll->a };
+	int n = ll->n;
+	double k;
+	Instr *root = matchScale(mt, ins, &k);
+	if (replaceInstr(mt, root, OP_RSV, args, 3))
+		return -1;
+	root->n = n;
+	root->m = 0;
+	root->f = k;
+	return 0;
+}
+
+/* EMA(X,S)-EMA(X,L) */
+static int matchDIF(Matcher *mt, Instr *ins)
+{
+	if (ins->op != OP_ARITH_AA || ins->n != '-')
+		return 0;
+	Instr *e1 = matchTemp(mt, ins->a, OP_EMA);
+	Instr *e2 = matchTemp(mt, ins->b, OP_EMA);
+	if (!e1 || !e2 || e1->a != e2->a)
+		return 0;
+
+	int args[3] = { e1->a, e1->dst, e2->dst };
+	int s = e1->n, l = e2->n;
+	removeInstr(mt, e1);
+	removeInstr(mt, e2);
+	if (replaceInstr(mt, ins, OP_DIF, args, 3))
+		return -1;
+	ins->n = s;
+	ins->m = l;
+	ins->f = 0;
+	return 0;
+}
+
+int programMatchIdioms(Program *prog)
+{
+	Matcher mt;
+	mt.prog = prog;
+	mt.nmatched = 0;
+	mt.removed = (unsigned char *)malloc(prog->instrs.size > 0 ? prog->instrs.size : 1);
+	if (!mt.removed)
+		return -1;
+	memset(mt.removed, 0, prog->instrs.size);
+	if (useDefInit(&mt.ud, prog)) {
+		free(mt.removed);
+		return -1;
+	}
+
+	/* ָ˳, ϲָڽָǰ */
+	int ret = 0;
+	for (int i = 0; i < prog->instrs.size && !ret; ++i) {
+		Instr *ins = (Instr *)arrayGet(&prog->instrs, i);
+		if (mt.removed[i])
+			continue;
+		int matched = mt.nmatched;
+		ret = matchRSI(&mt, ins);
+		if (!ret && matched == mt.nmatched)
+			ret = matchRSV(&mt, ins);
+		if (!ret && matched == mt.nmatched)
+			ret = matchDIF(&mt, ins);
+	}
+
+	/* ״ָ̬programRemoveDeadɾ, ɾ */
+	Instr *instrs = (Instr *)prog->instrs.data;
+	int size = 0;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		if (!mt.removed[i])
+			instrs[size++] = instrs[i];
+	}
+	prog->instrs.size = size;
+	useDefFree(&mt.ud);
+	free(mt.removed);
+	if (ret || mt.nmatched == 0)
+		return ret;
+	debug("ʶ%dָд\n", mt.nmatched);
+	/* ʹõм */
+	return programRemoveDead(prog);
+}
+
+/* ------ ָʶ ------ */
+
+}
@@ -5,9 +5,14 @@
 #include <malloc.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <limits>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 #include "base.h"
 #include "parser-impl.h"
 
@@ -20,6 +25,7 @@ namespace tg {
 
 static HashTable variableCtx; /* <char *, ValueFn> бCLOSE */
 static HashTable functionCtx; /* <char *, ValueFn> кMA */
+static HashTable pureCtx; /* <char *, ValueFn> ֻɲĺ */
 
 int registerVariable(const char *name, ValueFn fn)
 {
@@ -43,6 +49,15 @@ int registerFunction(const char *name, ValueFn fn)
 	return 0;
 }
 
+int registerPureFunction(const char *name, ValueFn fn)
+{
+	if (registerFunction(name, fn))
+		return -1;
+	if (hashTableInsert(&pureCtx, (const void *)name, (void *)fn, 0))
+		return -1;
+	return 0;
+}
+
 ValueFn findFunction(const char *name)
 {
 	ValueFn fn;
@@ -51,6 +66,33 @@ ValueFn findFunction(const char *name)
 	return fn;
 }
 
+/* htвfnע, ûз0 */
+static const char *findName(HashTable *ht, ValueFn fn)
+{
+	for (int i = 0; i < ht->dataCapacity; ++i) {
+		for (HashNode *p = ht->lookups[i]; p; p = p->next) {
+			if ((ValueFn)p->value == fn)
+				return (const char *)p->key;
+		}
+	}
+	return 0;
+}
+
+const char *findVariableName(ValueFn fn)
+{
+	return findName(&variableCtx, fn);
+}
+
+const char *findFunctionName(ValueFn fn)
+{
+	return findName(&functionCtx, fn);
+}
+
+bool isPureFunction(ValueFn fn)
+{
+	return findName(&pureCtx, fn) != 0;
+}
+
 #ifdef NDEBUG
 static void debugHashtable(HashTable *) {}
 #else
@@ -74,25 +116,26 @@ void indicatorInit()
 {
 	hashTableInit(&variableCtx, 1000, cstrCmp, cstrHash);
 	hashTableInit(&functionCtx, 1000, cstrCmp, cstrHash);
+	hashTableInit(&pureCtx, 1000, cstrCmp, cstrHash);
 	
 	registerVariable("OPEN", I_OPEN);
 	registerVariable("HIGH", I_HIGH);
 	registerVariable("LOW", I_LOW);
 	registerVariable("CLOSE", I_CLOSE);
 	
-	registerFunction("ADD", I_ADD);
-	registerFunction("SUB", I_SUB);
-	registerFunction("MUL", I_MUL);
-	registerFunction("DIV", I_DIV);
+	registerPureFunction("ADD", I_ADD);
+	registerPureFunction("SUB", I_SUB);
+	registerPureFunction("MUL", I_MUL);
+	registerPureFunction("DIV", I_DIV);
 	
-	registerFunction("REF", I_REF);
-	registerFunction("MAX", I_MAX);
-	registerFunction("ABS", I_ABS);
-	registerFunction("HHV", I_HHV);
-	registerFunction("LLV", I_LLV);
-	registerFunction("MA", I_MA);
-	registerFunction("EMA", I_EMA);
-	registerFunction("SMA", I_SMA);
+	registerPureFunction("REF", I_REF);
+	registerPureFunction("MAX", I_MAX);
+	registerPureFunction("ABS", I_ABS);
+	registerPureFunction("HHV", I_HHV);
+	registerPureFunction("LLV", I_LLV);
+	registerPureFunction("MA", I_MA);
+	registerPureFunction("EMA", I_EMA);
+	registerPureFunction("SMA", I_SMA);
 	//debugHashtable(&functionCtx);
 }
 
@@ -100,14 +143,148 @@ void indicatorShutdown()
 {
 	hashTableFree(&variableCtx);
 	hashTableFree(&functionCtx);
+	hashTableFree(&pureCtx);
+}
+
+/* ------ еڴ濪ʼ ------ */
+
+/* reallocʱ, Kʱtick·мͣ, ʱڴҲҪ.
+ * ֱmmap, ʱmremapֻƶҳ, , ڴ水ҳʹ.
+ * Ȼ, ں˲Ҫı. ƽ̨Ȼrealloc */
+#if defined(__linux__)
+#define TG_SERIES_MREMAP
+#endif
+
+/* Сֽmmap */
+#define SERIES_MAP_MIN (256 * 1024)
+
+/* аж, , ѭд,
+ * ҪͷʣµԪ. һsize֮ԪNAN, Ԫ
+ * Чֵ. ֻһ, ʱд·Ĳ, mmapҳõʱŷ
+ * ڴ, Ҳ. mmapڴ水ҳ */
+#define SERIES_ALIGN 64
+
+/* ȡ, elemΪÿԪصֽ */
+static inline int seriesRound(int capacity, size_t elem)
+{
+	int n = (int)(SERIES_ALIGN / elem);
+	return (capacity + n - 1) / n * n;
+}
+
+static void *seriesAlloc(size_t bytes)
+{
+#ifdef _WIN32
+	return _aligned_malloc(bytes, SERIES_ALIGN);
+#else
+	void *mem = 0;
+	if (posix_memalign(&mem, SERIES_ALIGN, bytes))
+		return 0;
+	return mem;
+#endif
+}
+
+static void seriesAlignedFree(void *fs)
+{
+#ifdef _WIN32
+	_aligned_free(fs);
+#else
+	free(fs);
+#endif
+}
+
+/* bytesֽڵǷmmap, ֻɴС */
+static inline bool seriesMapped(size_t bytes)
+{
+#ifdef TG_SERIES_MREMAP
+	return bytes >= SERIES_MAP_MIN;
+#else
+	(void)bytes;
+	return false;
+#endif
+}
+
+/* fsoldbytesbytes(), ԭ. ʧܷ0, fs */
+static void *seriesRealloc(void *fs, size_t oldbytes, size_t bytes)
+{
+	assert(bytes % SERIES_ALIGN == 0);
+	if (!fs)
+		oldbytes = 0;
+	void *mem;
+#ifdef TG_SERIES_MREMAP
+	if (seriesMapped(bytes)) {
+		if (fs && seriesMapped(oldbytes)) {
+			mem = mremap(fs, oldbytes, bytes, MREMAP_MAYMOVE);
+		} else { /* mallocmmapʱһ, SERIES_MAP_MIN */
+			mem = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mem != MAP_FAILED && fs) {
+				memcpy(mem, fs, oldbytes);
+				seriesAlignedFree(fs);
+			}
+		}
+		return mem == MAP_FAILED ? 0 : mem;
+	}
+#endif
+	/* realloc֤, µٸ */
+	mem = seriesAlloc(bytes);
+	if (!mem)
+		return 0;
+	if (fs) {
+		memcpy(mem, fs, oldbytes);
+		seriesAlignedFree(fs);
+	}
+	return mem;
+}
+
+static void seriesFree(void *fs, size_t bytes)
+{
+	if (!fs)
+		return;
+#ifdef TG_SERIES_MREMAP
+	if (seriesMapped(bytes)) {
+		munmap(fs, bytes);
+		return;
+	}
+#endif
+	(void)bytes;
+	seriesAlignedFree(fs);
+}
+
+/* ÿԪصֽ */
+static inline size_t valueElemSize(const Value *v)
+{
+	return v->type == VT_ARRAY_FLOAT ? sizeof(float) : sizeof(double);
+}
+
+/* ռõֽ */
+static inline size_t valueBytes(const Value *v)
+{
+	return valueElemSize(v) * (size_t)v->capacity;
+}
+
+/* һsize֮ԪNAN, һ. ͼͽõڴ治Լ, д */
+static void valuePadTail(Value *v)
+{
+	if (v->mem != VM_OWN)
+		return;
+	int to = seriesRound(v->size, valueElemSize(v));
+	assert(to <= v->capacity);
+	if (v->type == VT_ARRAY_FLOAT) {
+		for (int i = v->size; i < to; ++i)
+			v->f32s[i] = NAN;
+	} else {
+		for (int i = v->size; i < to; ++i)
+			v->fs[i] = NAN;
+	}
 }
 
+/* ------ еڴ ------ */
+
 Value *valueNew(enum ValueType ty)
 {
 	Value *v = (Value *)malloc(sizeof(*v));
 	if (!v)
 		return 0;
-	v->isOwnMem = false;
+	v->mem = VM_NONE;
 	v->type = ty;
 	v->i = 0;
 	v->f = 0;
@@ -115,15 +292,22 @@ Value *valueNew(enum ValueType ty)
 	v->size = 0;
 	v->capacity = 0;
 	v->no = 0;
+	v->keep = 0;
+	v->dropped = 0;
+	v->state = 0;
+	v->version = 0;
+	v->base = 0;
+	v->offset = 0;
 	return v;
 }
 
 void valueFree(Value *v)
 {
 	if (v) {
-		if (v->isOwnMem) {
-			free(v->fs);
+		if (v->mem == VM_OWN) {
+			seriesFree(v->fs, valueBytes(v));
 		}
+		free(v->state);
 		free(v);
 	}
 }
@@ -132,22 +316,159 @@ bool valueExtend(Value *v, int capacity)
 {
 	assert(v && capacity >= 0);
 	if (v->capacity < capacity) {
-		double *mem = (double *)realloc(v->fs, (sizeof(*mem) * capacity));
+		/* ĽÿֻһԪ, , ÿK߶· */
+		size_t elem = valueElemSize(v);
+		int cap = seriesRound(v->capacity * 2 > capacity ? v->capacity * 2 : capacity, elem);
+		bool own = v->mem == VM_OWN;
+		void *mem = seriesRealloc(own ? v->fs : 0, own ? valueBytes(v) : 0, elem * (size_t)cap);
 		if (!mem)
 			return false;
-		v->isOwnMem = true;
-		v->fs = mem;
-		v->capacity = capacity;
+		/* ͼͽõڴ渴һ, ԺԼ */
+		if (!own && v->fs && v->size > 0)
+			memcpy(mem, valueData(v), elem * v->size);
+		if (mem != (void *)v->fs)
+			v->version++;
+		v->mem = VM_OWN;
+		v->base = 0;
+		v->offset = 0;
+		v->fs = (double *)mem;
+		v->capacity = cap;
+		valuePadTail(v);
+	}
+	return true;
+}
+
+bool valueResize(Value *v, int rsize, int64_t no)
+{
+	assert(v && rsize >= 0);
+	int logical = rsize;
+	if (v->keep && v->no) { /* Ҫȡһ, һ */
+		int64_t need = no - v->no + 2;
+		if (need < v->keep)
+			need = v->keep;
+		if (need < rsize)
+			rsize = (int)need;
+	}
+	if (!valueExtend(v, rsize))
+		return false;
+	/* ѾԪбűµĵһԪСı */
+	int64_t drop = v->no ? (no - rsize) - (v->no - v->size) : 0;
+	if (drop > 0) {
+		int left = v->size - (int)(drop < v->size ? drop : v->size);
+		size_t elem = valueElemSize(v);
+		memmove(v->fs, (char *)v->fs + elem * (v->size - left), elem * left);
 	}
+	v->size = rsize;
+	v->dropped = logical - rsize;
+	valuePadTail(v);
 	return true;
 }
 
+void valueTrim(Value *v, int keep)
+{
+	if (!v || v->mem != VM_OWN || keep <= 0)
+		return;
+	v->keep = keep;
+	size_t elem = valueElemSize(v);
+	if (v->size > keep) {
+		memmove(v->fs, (char *)v->fs + elem * (v->size - keep), elem * keep);
+		v->dropped += v->size - keep;
+		v->size = keep;
+	}
+	/* ͷԺȫĴС, С. ֻFLOAT32ȡ, ûͼ, 汾 */
+	int cap = seriesRound(keep * 2, elem);
+	if (v->capacity <= cap)
+		return;
+	void *mem = seriesRealloc(0, 0, elem * (size_t)cap);
+	if (!mem)
+		return;
+	memcpy(mem, v->fs, elem * v->size);
+	seriesFree(v->fs, valueBytes(v));
+	v->fs = (double *)mem;
+	v->capacity = cap;
+	valuePadTail(v);
+}
+
+size_t valueSeriesBytes(const Value *v)
+{
+	return v && v->mem == VM_OWN ? valueBytes(v) : 0;
+}
+
+void valueBorrow(Value *v, Value *buf)
+{
+	assert(v && buf && v != buf);
+	if (v->mem == VM_OWN)
+		seriesFree(v->fs, valueBytes(v));
+	v->fs = buf->fs;
+	v->capacity = buf->capacity;
+	v->mem = VM_BORROW;
+	v->base = 0;
+}
+
+void valueGiveBack(Value *v, Value *buf)
+{
+	assert(v && buf && v != buf);
+	if (v->mem != VM_OWN)
+		return;
+	/* ֻ, ʱܷ֮ǰԪ */
+	if (buf->capacity > v->capacity) {
+		memcpy(buf->fs, v->fs, sizeof(*v->fs) * v->size);
+		seriesFree(v->fs, valueBytes(v));
+	} else {
+		if (buf->mem == VM_OWN)
+			seriesFree(buf->fs, valueBytes(buf));
+		buf->fs = v->fs;
+		buf->capacity = v->capacity;
+		buf->mem = VM_OWN;
+	}
+	v->fs = buf->fs;
+	v->capacity = buf->capacity;
+	v->mem = VM_BORROW;
+}
+
+void valueView(Value *v, const Value *base, int offset, int size, int64_t no)
+{
+	assert(v && base && v != base);
+	assert(offset >= 0 && size >= 0 && offset + size <= base->size);
+	if (v->mem == VM_OWN)
+		seriesFree(v->fs, valueBytes(v));
+	v->mem = VM_VIEW;
+	v->base = base;
+	v->offset = offset;
+	v->fs = base->fs + offset;
+	v->capacity = 0;
+	v->size = size;
+	v->no = no;
+}
+
+bool valueViewValid(const Value *v)
+{
+	if (v->mem != VM_VIEW)
+		return true;
+	return v->fs == v->base->fs + v->offset && v->offset + v->size <= v->base->size;
+}
+
+const double *valueData(const Value *v)
+{
+	return v->mem == VM_VIEW ? v->base->fs + v->offset : v->fs;
+}
+
+void valueSetKeep(Value *v, int keep)
+{
+	assert(v && keep >= 0);
+	v->keep = keep;
+	if (keep)
+		valueExtend(v, keep * 2);
+}
+
 double valueGet(const Value *v, int i)
 {
 	assert(v && v->fs);
-	assert((v->isOwnMem && i < v->capacity) || (!v->isOwnMem));
+	assert(v->mem != VM_OWN || i < v->capacity);
 	assert(i >= 0 && i < v->size);
-	return v->fs[i];
+	if (v->type == VT_ARRAY_FLOAT)
+		return v->f32s[i];
+	return valueData(v)[i];
 }
 
 void valueSet(Value *v, int i, double f)
@@ -156,23 +477,116 @@ void valueSet(Value *v, int i, double f)
 	assert(i >= 0 && i < v->capacity);
 	assert(i >= 0 && i < v->size);
 	v->fs[i] = f;
+	v->version++;
+}
+
+unsigned int valueVersion(const Value *v)
+{
+	return v ? v->version : 0;
+}
+
+void valueRewind(Value *v, int64_t no)
+{
+	assert(v && no >= 0);
+	if (!v->no || no >= v->no)
+		return;
+	/* ֱ±ĶӦ, ΪnoԪ */
+	int64_t size = v->size - (v->no - no);
+	if (size < 2) {
+		v->no = 0;
+		return;
+	}
+	v->size = (int)size;
+	v->no = no;
+	valuePadTail(v);
+}
+
+void valueRewindQuote(Value *v, int64_t no, int64_t last)
+{
+	assert(v && no >= 0);
+	if (!v->no)
+		return;
+	int64_t shift = last > v->no ? last - v->no : 0;
+	valueRewind(v, no > shift ? no - shift : 0);
 }
 
 void valueAdd(Value *v, double f)
 {
 	assert(v && v->fs && v->capacity > 0);
-	if (v->size >= v->capacity) {
-		double *mem = (double *)realloc(v->fs, (sizeof(*mem) * v->capacity * 2));
-		if (!mem)
-			return;
-		v->isOwnMem = true;
-		v->fs = mem;
-		v->capacity = v->capacity * 2;
+	if (v->keep && v->size >= v->keep * 2) {
+		/* ǰԪ, ֻkeep. ÿkeepԪƶһ */
+		memmove(v->fs, v->fs + v->size - v->keep, sizeof(*v->fs) * v->keep);
+		v->size = v->keep;
 	}
+	if (v->size >= v->capacity && !valueExtend(v, v->capacity * 2))
+		return;
 	assert(v->size >= 0 && v->size < v->capacity);
 	v->fs[v->size] = f;
 	v->size++;
 	v->no++;
+	v->version++;
+	valuePadTail(v);
+}
+
+void valueAddN(Value *v, const double *fs, int n)
+{
+	assert(v && n >= 0);
+	if (n == 0)
+		return;
+	if (v->keep && v->size > v->keep) {
+		memmove(v->fs, v->fs + v->size - v->keep, sizeof(*v->fs) * v->keep);
+		v->size = v->keep;
+	}
+	if (!valueExtend(v, v->size + n))
+		return;
+	memcpy(v->fs + v->size, fs, sizeof(*fs) * n);
+	v->size += n;
+	v->no += n;
+	v->version++;
+	valuePadTail(v);
+}
+
+void quoteAppendBar(Quote *q, double open, double high, double low, double close)
+{
+	assert(q);
+	valueAdd(q->open, open);
+	valueAdd(q->high, high);
+	valueAdd(q->low, low);
+	valueAdd(q->close, close);
+}
+
+/* ֵûб仯ʱ޸, 汾Ҳ */
+static void quoteSetLast(Value *v, double f)
+{
+	if (v->fs[v->size - 1] != f)
+		valueSet(v, v->size - 1, f);
+}
+
+void quoteUpdateLastBar(Quote *q, double open, double high, double low, double close)
+{
+	assert(q && q->close->size > 0);
+	quoteSetLast(q->open, open);
+	quoteSetLast(q->high, high);
+	quoteSetLast(q->low, low);
+	quoteSetLast(q->close, close);
+}
+
+void quoteAppendBars(Quote *q, const double *open, const double *high, const double *low, const double *close, int n)
+{
+	assert(q && n >= 0);
+	valueAddN(q->open, open, n);
+	valueAddN(q->high, high, n);
+	valueAddN(q->low, low, n);
+	valueAddN(q->close, close, n);
+}
+
+void quoteSetKeep(Quote *q, int keep)
+{
+	assert(q);
+	valueSetKeep(q->open, keep);
+	valueSetKeep(q->high, keep);
+	valueSetKeep(q->low, keep);
+	valueSetKeep(q->close, keep);
 }
 
 int isValueValid(double f)
@@ -215,10 +629,10 @@ Value *CLOSE(void *parser)
 }
 
 /* 㣬XY(Array)opΪ('+','-','*','/') */
-static Value *suanShuYunSuan_AA(const Value *X, const Value *Y, char op, Value *R)
+Value *suanShuYunSuan_AA(const Value *X, const Value *Y, char op, Value *R)
 {
-	int bno; /* ʼ */
-	int xbno; /* XĿʼ */
+	int64_t bno; /* ʼ */
+	int64_t xbno; /* XĿʼ */
 
 	if (!R) {
 		R = valueNew(VT_ARRAY_DOUBLE);
@@ -239,53 +653,55 @@ static Value *suanShuYunSuan_AA(const Value *X, const Value *Y, char op, Value *
 	 *      -------------- Y
 	 *      -------------- R */
 	if (Y->size > 0 && Y->size < X->size) {
-		int y0_xno = xbno + X->size - Y->size; /* YеĵһԪXеı */
+		int64_t y0_xno = xbno + X->size - Y->size; /* YеĵһԪXеı */
 		if (bno < y0_xno) {
 			bno = y0_xno;
 		}
 	}
 	
 	int rsize = X->size > Y->size ? Y->size : X->size;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
 	
-	/* ĺ濪ʼ */
-	int xi = X->size - 1;
-	int yi = Y->size - 1;
-	int ri = R->size - 1;
-	for (int eno = X->no; eno >= bno; --eno, --xi, --yi, --ri) {
-		assert(xi >= 0 && xi < X->size);
-		assert(yi >= 0 && yi < Y->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = NAN;
-		switch (op) {
-		case '+': res = valueGet(X, xi) + valueGet(Y, yi); break;
-		case '-': res = valueGet(X, xi) - valueGet(Y, yi); break;
-		case '*': res = valueGet(X, xi) * valueGet(Y, yi); break;
-		case '/':
-			if (valueGet(Y, yi) != 0) {
-				res = valueGet(X, xi) / valueGet(Y, yi);
-			} else {
-				//  rno = kno;
-			}
-			break;
-		default:
-			break;
-		}
-		valueSet(R, ri, res);
+	/* ĺ濪ʼ, ѭж */
+	int count = (int)(X->no - bno + 1);
+	assert(count <= X->size && count <= Y->size && count <= R->size);
+	const double *x = X->fs + X->size - count;
+	const double *y = Y->fs + Y->size - count;
+	double *r = R->fs + R->size - count;
+	switch (op) {
+	case '+':
+		for (int i = 0; i < count; ++i)
+			r[i] = x[i] + y[i];
+		break;
+	case '-':
+		for (int i = 0; i < count; ++i)
+			r[i] = x[i] - y[i];
+		break;
+	case '*':
+		for (int i = 0; i < count; ++i)
+			r[i] = x[i] * y[i];
+		break;
+	case '/':
+		for (int i = 0; i < count; ++i)
+			r[i] = y[i] != 0 ? x[i] / y[i] : NAN; //  rno = kno;
+		break;
+	default:
+		for (int i = 0; i < count; ++i)
+			r[i] = NAN;
+		break;
 	}
 	R->no = X->no;
 	return R;
 }
 
 /* 㣬X(Array),Y֣opΪ('+','-','*','/') */
-static Value *suanShuYunSuan_AN(const Value *X, double Y, char op, Value *R)
+Value *suanShuYunSuan_AN(const Value *X, double Y, char op, Value *R)
 {
-	int bno; /* ʼ */
-	int xbno; /* XĿʼ */
+	int64_t bno; /* ʼ */
+	int64_t xbno; /* XĿʼ */
 
 	if (!R) {
 		R = valueNew(VT_ARRAY_DOUBLE);
@@ -301,44 +717,51 @@ static Value *suanShuYunSuan_AN(const Value *X, double Y, char op, Value *R)
 	bno = R->no ? R->no : (xbno);
 	
 	int rsize = X->size;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
 	
-	/* ĺ濪ʼ */
-	int xi = X->size - 1;
-	int ri = R->size - 1;
-	for (int eno = X->no; eno >= bno; --eno, --xi, --ri) {
-		assert(xi >= 0 && xi < X->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = NAN;
-		switch (op) {
-		case '+': res = valueGet(X, xi) + Y; break;
-		case '-': res = valueGet(X, xi) - Y; break;
-		case '*': res = valueGet(X, xi) * Y; break;
-		case '/':
-			if (Y != 0) {
-				res = valueGet(X, xi) / Y;
-			} else {
-				//  rno = kno;
-			}
-			break;
-		default:
+	/* ĺ濪ʼ, ͳǷΪ0ѭж */
+	int count = (int)(X->no - bno + 1);
+	assert(count <= X->size && count <= R->size);
+	const double *x = X->fs + X->size - count;
+	double *r = R->fs + R->size - count;
+	switch (op) {
+	case '+':
+		for (int i = 0; i < count; ++i)
+			r[i] = x[i] + Y;
+		break;
+	case '-':
+		for (int i = 0; i < count; ++i)
+			r[i] = x[i] - Y;
+		break;
+	case '*':
+		for (int i = 0; i < count; ++i)
+			r[i] = x[i] * Y;
+		break;
+	case '/':
+		if (Y != 0) {
+			for (int i = 0; i < count; ++i)
+				r[i] = x[i] / Y;
 			break;
 		}
-		valueSet(R, ri, res);
+		//  rno = kno;
+		/* Ϊ0, 䵽default */
+	default:
+		for (int i = 0; i < count; ++i)
+			r[i] = NAN;
+		break;
 	}
 	R->no = X->no;
 	return R;
 }
 
 /* 㣬X֣Y(Array)opΪ('+','-','*','/') */
-static Value *suanShuYunSuan_NA(double X, const Value *Y, char op, Value *R)
+Value *suanShuYunSuan_NA(double X, const Value *Y, char op, Value *R)
 {
-	int bno; /* ʼ */
-	int ybno; /* YĿʼ */
+	int64_t bno; /* ʼ */
+	int64_t ybno; /* YĿʼ */
 
 	if (!R) {
 		R = valueNew(VT_ARRAY_DOUBLE);
@@ -354,34 +777,37 @@ static Value *suanShuYunSuan_NA(double X, const Value *Y, char op, Value *R)
 	bno = R->no ? R->no : (ybno);
 	
 	int rsize = Y->size;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, Y->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
 	
-	/* ĺ濪ʼ */
-	int yi = Y->size - 1;
-	int ri = R->size - 1;
-	for (int eno = Y->no; eno >= bno; --eno, --yi, --ri) {
-		assert(yi >= 0 && yi < Y->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = NAN;
-		switch (op) {
-		case '+': res = X + valueGet(Y, yi); break;
-		case '-': res = X - valueGet(Y, yi); break;
-		case '*': res = X * valueGet(Y, yi); break;
-		case '/':
-			if (valueGet(Y, yi) != 0) {
-				res = X / valueGet(Y, yi);
-			} else {
-				//  rno = kno;
-			}
-			break;
-		default:
-			break;
-		}
-		valueSet(R, ri, res);
+	/* ĺ濪ʼ, ѭж */
+	int count = (int)(Y->no - bno + 1);
+	assert(count <= Y->size && count <= R->size);
+	const double *y = Y->fs + Y->size - count;
+	double *r = R->fs + R->size - count;
+	switch (op) {
+	case '+':
+		for (int i = 0; i < count; ++i)
+			r[i] = X + y[i];
+		break;
+	case '-':
+		for (int i = 0; i < count; ++i)
+			r[i] = X - y[i];
+		break;
+	case '*':
+		for (int i = 0; i < count; ++i)
+			r[i] = X * y[i];
+		break;
+	case '/':
+		for (int i = 0; i < count; ++i)
+			r[i] = y[i] != 0 ? X / y[i] : NAN; //  rno = kno;
+		break;
+	default:
+		for (int i = 0; i < count; ++i)
+			r[i] = NAN;
+		break;
 	}
 	R->no = Y->no;
 	return R;
@@ -532,9 +958,7 @@ Value *REF(const Value *X, int N, Value *R)
 	/* ----------------- X
 	 *              N
 	 * ------------- R */
-	R->fs = (double *)X->fs;
-	R->size = X->size - N;
-	R->no = X->no - N;
+	valueView(R, X, 0, X->size - N, X->no - N);
 
 	return R;
 }
@@ -553,19 +977,18 @@ Value *MAX(const Value *X, double M, Value *R)
 	}
 	
 	int rsize = X->size;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
 	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t bno = R->no ? R->no : xbno; /* ʼ */
 	
 	/* ĺ濪ʼ */
 	int xi = X->size - 1;
 	int ri = R->size - 1;
-	for (int kno = X->no; kno >= bno; --kno, --xi, --ri) {
+	for (int64_t kno = X->no; kno >= bno; --kno, --xi, --ri) {
 		assert(xi >= 0 && xi < X->size);
 		assert(ri >= 0 && ri < R->size);
 		double res = valueGet(X, xi);
@@ -589,19 +1012,18 @@ Value *ABS(const Value *X, Value *R)
 	}
 	
 	int rsize = X->size;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
 	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t bno = R->no ? R->no : xbno; /* ʼ */
 	
 	/* ĺ濪ʼ */
 	int xi = X->size - 1;
 	int ri = R->size - 1;
-	for (int kno = X->no; kno >= bno; --kno, --xi, --ri) {
+	for (int64_t kno = X->no; kno >= bno; --kno, --xi, --ri) {
 		assert(xi >= 0 && xi < X->size);
 		assert(ri >= 0 && ri < R->size);
 		double res = valueGet(X, xi);
@@ -612,55 +1034,198 @@ Value *ABS(const Value *X, Value *R)
 	return R;
 }
 
-/* R:=HHV(X, N) 
- * --------------- X
- *   N  ---------- R */
-Value *HHV(const Value *X, int N, Value *R)
+Value *FLOAT32(const Value *X, Value *R)
 {
-	assert(X && N >= 0);
-	if (!X || X->size == 0 || X->size < N)
+	if (!X || X->type != VT_ARRAY_DOUBLE || X->size == 0)
 		return R;
 	if (!R) {
-		R = valueNew(X->type);
+		R = valueNew(VT_ARRAY_FLOAT);
 		if (!R)
 			return 0;
 	}
-	
-	int rsize = X->size - N + 1;
-	if (!valueExtend(R, rsize)) {
+	assert(R->type == VT_ARRAY_FLOAT);
+
+	/* XֻԪ(valueTrim), Ȼȫ */
+	int rsize = X->size + X->dropped;
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
-	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	xbno = xbno + N - 1; /* ͷʼĵNԪ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
-	
-	/* ĺ濪ʼ */
-	int xi = X->size - 1;
-	int ri = R->size - 1;
-	for (int kno = X->no; kno >= bno; --kno, --xi, --ri) {
-		assert(xi >= 0 && xi < X->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = valueGet(X, xi);
-		for (int j = xi, count = 1; j >= 0 && count < N; --j, ++count) {
-			double f = valueGet(X, j);
-			if (f > res) {
-				res = f;
+
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t bno = R->no ? R->no : xbno; /* ʼ */
+	int count = (int)(X->no - bno + 1);
+	assert(count <= X->size && count <= R->size);
+	const double *x = valueData(X) + X->size - count;
+	float *r = R->f32s + R->size - count;
+	for (int i = 0; i < count; ++i)
+		r[i] = (float)x[i];
+	R->no = X->no;
+	return R;
+}
+
+/* ------ ڵֵʼ ------ */
+
+/* ʱڲСֱӱȽ, Ҫ.
+ * test-BenchʱNΪ5060֮űֱӱȽϿ */
+#define EXTREME_SCAN_MAX 48
+/* ûжпԼʱ, (ʹڴС)van Herkֿ */
+#define EXTREME_BATCH_MIN 64
+/* ֿʱڲСȻֱӱȽ, ͷNΪ16ʱֱӱȽϿ, 20ʱֿ */
+#define EXTREME_BATCH_SCAN_MAX 16
+
+/* laterǷȡearlier: ʱȡ, NANȽ */
+static inline bool isBetter(double later, double earlier, bool isMax)
+{
+	if (earlier != earlier)
+		return true;
+	return isMax ? later >= earlier : later <= earlier;
+}
+
+int extremeStateSize(int N)
+{
+	int cap = 1;
+	while (cap < N)
+		cap <<= 1;
+	return (int)sizeof(ExtremeState) + (int)sizeof(int64_t) * (cap - 1);
+}
+
+void extremeStateInit(ExtremeState *st, int N)
+{
+	int cap = 1;
+	while (cap < N)
+		cap <<= 1;
+	st->N = N;
+	st->no = 0;
+	st->head = 0;
+	st->count = 0;
+	st->mask = cap - 1;
+}
+
+/* ΪnoԪط, еֵ, ͷǴڵֵ */
+static inline void extremePush(ExtremeState *st, const double *xs, int64_t xbno, int64_t no, bool isMax)
+{
+	while (st->count && st->nos[st->head & st->mask] <= no - st->N) {
+		st->head++;
+		st->count--;
+	}
+	double x = xs[no - xbno];
+	if (x == x) {
+		while (st->count && isBetter(x, xs[st->nos[(st->head + st->count - 1) & st->mask] - xbno], isMax))
+			st->count--;
+		st->nos[(st->head + st->count) & st->mask] = no;
+		st->count++;
+	}
+	st->no = no;
+}
+
+/* noβĴڵֵ, no֮ǰԪ, ޸Ķ */
+static inline double extremePeek(const ExtremeState *st, const double *xs, int64_t xbno, int64_t no, bool isMax)
+{
+	double x = xs[no - xbno];
+	if (x != x)
+		return x;
+	for (int i = 0; i < st->count; ++i) {
+		int64_t k = st->nos[(st->head + i) & st->mask];
+		if (k > no - st->N) {
+			double f = xs[k - xbno];
+			return isBetter(x, f, isMax) ? x : f;
+		}
+	}
+	return x;
+}
+
+/* ·lastβĴгһԪ, ڼlast+1 */
+static void extremeRebuild(ExtremeState *st, const double *xs, int64_t xbno, int64_t last, bool isMax)
+{
+	st->head = 0;
+	st->count = 0;
+	st->no = 0;
+	int64_t k = last - st->N + 2;
+	for (k = k > xbno ? k : xbno; k <= last; ++k) {
+		extremePush(st, xs, xbno, k, isMax);
+	}
+}
+
+/* van Herk/Gil-Werman: ڴСֿ, ڵǰ׺ֵͺ׺ֵȽһ */
+static bool extremeBatch(const double *xs, int N, bool isMax, int n, double *rs)
+{
+	/* xs[0..n+N-2], rs[t]Ӧxs[t..t+N-1] */
+	int m = n + N - 1;
+	double *g = (double *)malloc(sizeof(double) * m * 2);
+	if (!g)
+		return false;
+	double *h = g + m;
+	for (int t = 0; t < m; ++t) {
+		g[t] = t % N == 0 || isBetter(xs[t], g[t-1], isMax) ? xs[t] : g[t-1];
+	}
+	for (int t = m - 1; t >= 0; --t) {
+		h[t] = t == m - 1 || (t + 1) % N == 0 || !isBetter(h[t+1], xs[t], isMax) ? xs[t] : h[t+1];
+	}
+	for (int t = 0; t < n; ++t) {
+		double x = xs[t + N - 1];
+		double f = isBetter(g[t + N - 1], h[t], isMax) ? g[t + N - 1] : h[t];
+		rs[t] = x != x ? x : f;
+	}
+	free(g);
+	return true;
+}
+
+void windowExtreme(const Value *X, int N, bool isMax, int64_t bno, int64_t eno, ExtremeState *st, double *rs)
+{
+	assert(N > 0 && bno <= eno && eno <= X->no);
+	const double *xs = X->fs;
+	int64_t xbno = X->no - (X->size - 1);
+	assert(bno - N + 1 >= xbno);
+	int n = (int)(eno - bno + 1);
+
+	bool cont = st && st->N == N && st->no && st->no == bno - 1;
+	if (!cont && N > EXTREME_BATCH_SCAN_MAX && n >= EXTREME_BATCH_MIN && n >= N
+			&& extremeBatch(xs + (bno - N + 1 - xbno), N, isMax, n, rs)) {
+		/* ´δeno+1߸һKʱ */
+		if (st && N > EXTREME_SCAN_MAX)
+			extremeRebuild(st, xs, xbno, eno < X->no ? eno : X->no - 1, isMax);
+		else if (st)
+			st->no = 0;
+		return;
+	}
+
+	if (N <= EXTREME_SCAN_MAX || !st) {
+		/* ֱӱȽ, Ǵеλ, ڲǽ: ڲܳû, ÿ
+		 * ֻȽN-1ԤѭĽ. Ƚϵ˳Ƚһ,
+		 * NANȽfalse: еNANȽ, ǰNANʱȻNAN */
+		const double *x = xs + (bno - N + 1 - xbno);
+		for (int i = 0; i < n; ++i)
+			rs[i] = x[i + N - 1];
+		for (int k = 0; k < N - 1; ++k) {
+			const double *y = x + k;
+			if (isMax) {
+				for (int i = 0; i < n; ++i)
+					rs[i] = y[i] > rs[i] ? y[i] : rs[i];
+			} else {
+				for (int i = 0; i < n; ++i)
+					rs[i] = y[i] < rs[i] ? y[i] : rs[i];
 			}
 		}
-		valueSet(R, ri, res);
+		if (st)
+			st->no = 0;
+		return;
+	}
+
+	if (!cont)
+		extremeRebuild(st, xs, xbno, bno - 1, isMax);
+	for (int64_t k = bno; k <= eno; ++k) {
+		rs[k - bno] = extremePeek(st, xs, xbno, k, isMax);
+		if (k < X->no) /* һK߿ܻ,  */
+			extremePush(st, xs, xbno, k, isMax);
 	}
-	R->no = X->no;
-	return R;
 }
 
-/* R:=LLV(X, N) */
-Value *LLV(const Value *X, int N, Value *R)
+/* HHVLLV, ״̬R->state */
+static Value *extremeKernel(const Value *X, int N, bool isMax, Value *R)
 {
 	assert(X && N >= 0);
-	if (!X || X->size == 0 || X->size < N)
+	if (!X || N <= 0 || X->size == 0 || X->size < N)
 		return R;
 	if (!R) {
 		R = valueNew(X->type);
@@ -669,42 +1234,88 @@ Value *LLV(const Value *X, int N, Value *R)
 	}
 	
 	int rsize = X->size - N + 1;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
-	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	xbno = xbno + N - 1; /* ͷʼĵNԪ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
-	
-	/* ĺ濪ʼ */
-	int xi = X->size - 1;
-	int ri = R->size - 1;
-	for (int kno = X->no; kno >= bno; --kno, --xi, --ri) {
-		assert(xi >= 0 && xi < X->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = valueGet(X, xi);
-		for (int j = xi, count = 1; j >= 0 && count < N; --j, ++count) {
-			double f = valueGet(X, j);
-			if (f < res) {
-				res = f;
-			}
+
+	ExtremeState *st = (ExtremeState *)R->state;
+	if (N > EXTREME_SCAN_MAX && (!st || st->N != N)) {
+		free(st);
+		st = (ExtremeState *)malloc(extremeStateSize(N));
+		R->state = st;
+		if (!st) {
+			valueFree(R);
+			return 0;
 		}
-		valueSet(R, ri, res);
+		extremeStateInit(st, N);
 	}
+	if (st && !R->no)
+		st->no = 0;
+	
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t first = xbno + N - 1; /* һ, RȫʱӦRĵ0Ԫ */
+	int64_t bno = R->no > first ? R->no : first; /* ʼ */
+	int64_t rbno = X->no - (R->size - 1); /* Rĵ0Ԫصı */
+	windowExtreme(X, N, isMax, bno, X->no, st, R->fs + (bno - rbno));
 	R->no = X->no;
 	return R;
 }
 
+/* R:=HHV(X, N) 
+ * --------------- X
+ *   N  ---------- R */
+Value *HHV(const Value *X, int N, Value *R)
+{
+	return extremeKernel(X, N, true, R);
+}
+
+/* R:=LLV(X, N) */
+Value *LLV(const Value *X, int N, Value *R)
+{
+	return extremeKernel(X, N, false, R);
+}
+
+/* ------ ڵֵ ------ */
+
+/* MA״̬, ڽstate. ںRԪһһӦ, ͬEMA,SMAһ
+ * ÿK߶Ǽ, ӱκһ¼(valueRewind)ԭĴں,
+ * ֻKʱΪʹѾ */
+struct MAState {
+	int M;
+	int64_t no; /* sumsһԱnoβĴڵĺ, 0ʾû */
+	int count, capacity;
+	double sums[1]; /* Աno-count+1noβĴڵĺ, ʵcapacity */
+};
+
+/* ΪMA_REANCHORıʱ, ƻ͵ۼ.
+ * ֻͱй, ʹͷĽȫһ */
+#define MA_REANCHOR 1024
+
+/* xs[xi-M+1..xi]ĺ */
+static double windowSum(const double *xs, int xi, int M)
+{
+	double sum = 0;
+	for (int j = xi - M + 1; j <= xi; ++j) {
+		sum += xs[j];
+	}
+	return sum;
+}
+
+/* ںΪNANʱ, ȥɵֵҲָܻ */
+static inline bool isFiniteSum(double f)
+{
+	return f - f == 0;
+}
+
 /* MA
 	ؼƶƽ
-	÷MA(X,M)XMռƶƽ */
+	÷MA(X,M)XMռƶƽ
+	ÿĴں, ͸һKʱǰһ, ÿKO(1) */
 Value *MA(const Value *X, int M, Value *R)
 {
 	assert(X && M > 0);
-	if (!X || X->size == 0 || X->size < M)
+	if (!X || M <= 0 || X->size == 0 || X->size < M)
 		return R;
 	if (!R) {
 		R = valueNew(X->type);
@@ -713,39 +1324,96 @@ Value *MA(const Value *X, int M, Value *R)
 	}
 	
 	int rsize = X->size - M + 1;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
+
+	MAState *st = (MAState *)R->state;
+	if (!st) {
+		st = (MAState *)malloc(sizeof(*st));
+		if (!st) {
+			valueFree(R);
+			return 0;
+		}
+		st->M = M;
+		st->no = 0;
+		st->count = 0;
+		st->capacity = 1;
+		R->state = st;
+	}
+	if (st->M != M || !R->no) {
+		st->M = M;
+		st->no = 0;
+		st->count = 0;
+	}
+	if (st->capacity < R->size) {
+		int capacity = st->capacity * 2 < R->size ? R->size : st->capacity * 2;
+		MAState *nst = (MAState *)realloc(st, offsetof(MAState, sums) + sizeof(double) * capacity);
+		if (!nst) {
+			valueFree(R);
+			return 0;
+		}
+		st = nst;
+		st->capacity = capacity;
+		R->state = st;
+	}
 	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t first = xbno + M - 1; /* һ, RȫʱӦRĵ0Ԫ */
+	int64_t bno = R->no > first ? R->no : first; /* ʼ */
+	int64_t rbno = X->no - (R->size - 1); /* Rĵ0Ԫصı */
+	int64_t sbno = st->no - st->count + 1; /* sumsĵ0ı */
+	bool cont = st->no && bno - 1 >= first && bno - 1 >= sbno && bno - 1 <= st->no;
+	double sum = cont ? st->sums[bno - 1 - sbno] : 0;
 	
-	/* ĺ濪ʼ */
-	int xi = X->size - 1;
-	int ri = R->size - 1;
-	for (int kno = X->no; kno >= bno; --kno, --xi, --ri) {
-		assert(xi >= 0 && xi < X->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = 0;
-		for (int j = xi, count = 1; j >= 0 && count < M; --j, ++count) {
-			res += valueGet(X, j);
-		}
-		res = res / M;
-		valueSet(R, ri, res);
+	/* ûǰһںʱ(Rͷ), bno֮ǰʹ,
+	 * ͷĽһ */
+	int64_t start = bno;
+	if (!cont) {
+		start = bno - bno % MA_REANCHOR;
+		if (start < first)
+			start = first;
+	}
+	
+	/* start֮ǰĴںͲ, Rǰ, űrbnoСĶ */
+	int64_t lo = sbno > rbno ? sbno : rbno;
+	if (st->no && st->no >= start - 1 && lo < start) {
+		if (sbno != rbno)
+			memmove(st->sums + (lo - rbno), st->sums + (lo - sbno), sizeof(double) * (size_t)(start - lo));
+	} else {
+		lo = start > rbno ? start : rbno;
 	}
+	
+	const double *xs = X->fs;
+	double *rs = R->fs;
+	for (int64_t kno = start; kno <= X->no; ++kno) {
+		int xi = (int)(kno - xbno);
+		if ((kno == start && !cont) || kno % MA_REANCHOR == 0 || !isFiniteSum(sum))
+			sum = windowSum(xs, xi, M);
+		else
+			sum += xs[xi] - xs[xi - M];
+		if (kno >= bno)
+			rs[kno - rbno] = sum / M;
+		if (kno >= rbno)
+			st->sums[kno - rbno] = sum;
+	}
+	st->no = X->no;
+	st->count = (int)(X->no - lo + 1);
 	R->no = X->no;
 	return R;
 }
 
-/* EMA
-	ָƶƽ
-	÷EMA(X,M)XMָƶƽ
-	㷨Y = (X*2 + Y'*(M-1)) / (M+1) */
-Value *EMA(const Value *X, int M, Value *R)
+/* EMA,SMAĵ״̬, ڽstate. һK֮ǰĽѾȷ(committed),
+ * һKߵĽݶ: һKʱ, committedһԪ */
+struct RecurState {
+	int64_t no; /* committedǱnoĽ, 0ʾû */
+	double committed;
+};
+
+/* R = (X*a + R'*b) / c, EMASMA */
+static Value *recurKernel(const Value *X, double a, double b, double c, Value *R)
 {
-	assert(X && M >= 0);
 	if (!X || X->size == 0)
 		return R;
 	if (!R) {
@@ -755,33 +1423,62 @@ Value *EMA(const Value *X, int M, Value *R)
 	}
 	
 	int rsize = X->size;
-	if (!valueExtend(R, rsize)) {
+	if (!valueResize(R, rsize, X->no)) {
 		valueFree(R);
 		return 0;
 	}
-	R->size = rsize;
+
+	RecurState *st = (RecurState *)R->state;
+	if (!st) {
+		st = (RecurState *)malloc(sizeof(*st));
+		if (!st) {
+			valueFree(R);
+			return 0;
+		}
+		st->no = 0;
+		R->state = st;
+	}
 	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t bno = R->no ? R->no : xbno; /* ʼ */
 	
-	/* ǰ */
-	int nosize = X->no - bno + 1;
+	/* ǰ, yһ */
+	int nosize = (int)(X->no - bno + 1);
 	int xi = X->size - nosize;
 	int ri = R->size - nosize;
-	for (int kno = bno; kno <= X->no; ++kno, ++xi, ++ri) {
+	bool hasy = ri > 0;
+	double y = 0;
+	if (hasy)
+		y = st->no == bno - 1 ? st->committed : R->fs[ri-1];
+	for (int64_t kno = bno; kno <= X->no; ++kno, ++xi, ++ri) {
 		assert(xi >= 0 && xi < X->size);
 		assert(ri >= 0 && ri < R->size);
-		double res = valueGet(X, xi);
-		if (ri > 0) { /* ֵ */
-			double y = valueGet(R, ri-1);
+		double res = X->fs[xi];
+		if (hasy) { /* ֵ */
 			assert(isValueValid(y));
-			res = (res * 2.0 + y * (M - 1)) / (M + 1);
+			res = (res * a + y * b) / c;
 		}
-		valueSet(R, ri, res);
+		R->fs[ri] = res;
+		if (kno == X->no - 1) { /* һK߿ܻ, ǰ */
+			st->no = kno;
+			st->committed = res;
+		}
+		y = res;
+		hasy = true;
 	}
 	R->no = X->no;
 	return R;
 }
+
+/* EMA
+	ָƶƽ
+	÷EMA(X,M)XMָƶƽ
+	㷨Y = (X*2 + Y'*(M-1)) / (M+1) */
+Value *EMA(const Value *X, int M, Value *R)
+{
+	assert(X && M >= 0);
+	return recurKernel(X, 2.0, M - 1, M + 1, R);
+}
 		
 /* SMA
 	ƽƶƽ
@@ -790,41 +1487,7 @@ Value *EMA(const Value *X, int M, Value *R)
 Value *SMA(const Value *X, int N, int M, Value *R)
 {
 	assert(X && M >= 0 && N > 0);
-	if (!X || X->size == 0)
-		return R;
-	if (!R) {
-		R = valueNew(X->type);
-		if (!R)
-			return 0;
-	}
-	
-	int rsize = X->size;
-	if (!valueExtend(R, rsize)) {
-		valueFree(R);
-		return 0;
-	}
-	R->size = rsize;
-	
-	int xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
-	int bno = R->no ? R->no : xbno; /* ʼ */
-	
-	/* ǰ */
-	int nosize = X->no - bno + 1;
-	int xi = X->size - nosize;
-	int ri = R->size - nosize;
-	for (int kno = bno; kno <= X->no; ++kno, ++xi, ++ri) {
-		assert(xi >= 0 && xi < X->size);
-		assert(ri >= 0 && ri < R->size);
-		double res = valueGet(X, xi);
-		if (ri > 0) { /* ֵ */
-			double y = valueGet(R, ri-1);
-			assert(isValueValid(y));
-			res = (res * M + y * (N - M)) / N;
-		}
-		valueSet(R, ri, res);
-	}
-	R->no = X->no;
-	return R;
+	return recurKernel(X, M, N - M, N, R);
 }
 
 /* ------------------------------------ ӿڿʼ ------------------ */
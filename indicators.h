@@ -1,6 +1,7 @@
 #ifndef TG_INDICAOTR_INDICATORS_H
 #define TG_INDICAOTR_INDICATORS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace tg {
@@ -9,31 +10,90 @@ enum ValueType {
 	VT_INT = 1,
 	VT_DOUBLE,
 	VT_ARRAY_DOUBLE,
+	VT_ARRAY_FLOAT, /* float洢Ľ, FLOAT32. ֻ, ں˲ */
 };
+/* еڴ */
+enum ValueMem {
+	VM_NONE = 0, /* ûڴ, ǵߵڴ, ͷ */
+	VM_OWN, /* Լ, valueFreeͷ */
+	VM_VIEW, /* ͼ: baseڴ, base->fs[offset]ʼ, . REF */
+	VM_BORROW, /* ùõĻ, valueBorrow */
+};
+
 struct Value {
-	bool isOwnMem;
+	enum ValueMem mem;
 	enum ValueType type;
 	union {
 		int i;
 		double f;
 		double *fs;
+		float *f32s; /* VT_ARRAY_FLOAT */
 	};
 	int size; /* С */
 	int capacity; /*  */
 	/* valuesһԪصı,Ԫصı
-	 * Ŵ1ʼʹñʶԪأԭڣsize=5000noԵ10000 */
-	int no;
+	 * Ŵ1ʼʹñʶԪأԭڣsize=5000noԵ10000.
+	 * 7x24Сʱһֱ, 64λ */
+	int64_t no;
+	int keep; /* ֻԪ, valueSetKeepvalueTrim. 0ʾȫ */
+	int dropped; /* valueTrimԺǰûбԪظ, ߼dropped+sizeԪ */
+	void *state; /* ں״̬(MAĴں), valueFreeͷ */
+	/* ÿθıʱ1: valueAdd,valueSet¼ָ.
+	 * ʱİ汾, ûб仯, programRun */
+	unsigned int version;
+	/* VM_VIEWʱõ. baseڴ滻˵ַ(valueExtend)ʱ汾1,
+	 * ͼ֮¼, Ѿͷŵڴ */
+	const Value *base;
+	int offset;
 };
 
 Value *valueNew(enum ValueType ty);
 void valueFree(Value *v);
 
+/* Ϊcapacity. еڴ水64ֽڶ, (8double),
+ * һsize֮ԪΪNAN, ں˿㵽sizeĩβ */
 bool valueExtend(Value *v, int capacity);
+/* RĴСΪrsize, һԪصıŽno. 붪ǰԪʱ,
+ * RѾԪظǰ, ŵĶӦ. ںvalueExtend.
+ * valueTrimԺֻR->noʼҪԪغǰһ, R->sizeСrsize,
+ * ںҪӺR± */
+bool valueResize(Value *v, int rsize, int64_t no);
+/* ֻkeepԪ, ڴ汻ͷ, ԺvalueResizeҲֻҪԪ.
+ * ֻֻFLOAT32ȡм, programTrimSources */
+void valueTrim(Value *v, int keep);
+/* Լڴֽ, ͼͽõڴ治 */
+size_t valueSeriesBytes(const Value *v);
+/* мռڴ, ǰbuf, 󻹻(programShareBuffers).
+ * ںvalueExtend˸ڴʱ, bufµڴ, ͷԭ. bufֻ */
+void valueBorrow(Value *v, Value *buf);
+void valueGiveBack(Value *v, Value *buf);
+
+/* vΪbaseдoffsetʼsizeԪ, һԪصıΪno. vԭڴ汻ͷ */
+void valueView(Value *v, const Value *base, int offset, int size, int64_t no);
+/* ͼbaseڴһ, ͼʱtrue */
+bool valueViewValid(const Value *v);
+/* еڴ, ͼǴbaseڵڴȡ */
+const double *valueData(const Value *v);
 
 double valueGet(const Value *v, int i);
 void valueSet(Value *v, int i, double f);
+/* vΪ0ʱ0 */
+unsigned int valueVersion(const Value *v);
+/* ӱnoʼ¼: R->no˻صno, ֮ǰԪغ͵״̬, ں˴.
+ * EMA,SMAȵƵ״̬ǰһ, ÿK߶Ǽ. ǰһԪѾnoΪ0ʱͷ */
+void valueRewind(Value *v, int64_t no);
+/* ınoʼ¼, lastǼvʱһKߵı.
+ * Ԫȡһı, REF(X,N)ʱN, ΪkԪضӦ
+ * k+NK, ҪvԼĲ˻ؼ */
+void valueRewindQuote(Value *v, int64_t no, int64_t last);
 /* һԪ */
 void valueAdd(Value *v, double f);
+/* nԪ. keepʱֻ֮ǰ, n֮ǰkeep,
+ * ںһμnµĽ */
+void valueAddN(Value *v, const double *fs, int n);
+/* ԪʱٱkeepԪ, ڴ治2*keep, ֮ǰĶ.
+ * ĽĴС仯, Ҳ. keepһparserLookbackõ */
+void valueSetKeep(Value *v, int keep);
 
 int isValueValid(double f); /* ֵǷЧ */
 
@@ -44,14 +104,31 @@ struct Quote {
 	Value *close;
 };
 
+/* : һK, иһK. ֮ǰK߲ٸı.
+ * ʱֵֻ仯Ӱ汾, ֻCLOSE仯ʱHHV(HIGH,N)Ȳ¼ */
+void quoteAppendBar(Quote *q, double open, double high, double low, double close);
+void quoteUpdateLastBar(Quote *q, double open, double high, double low, double close);
+/* һnK, ȱٵK */
+void quoteAppendBars(Quote *q, const double *open, const double *high, const double *low, const double *close, int n);
+/* ÿжֻkeepK, valueSetKeep */
+void quoteSetKeep(Quote *q, int keep);
+
 /* עOPEN,CLOSE;
  * עắMASMA */
 typedef Value *(*ValueFn)(void *parser, int argc, const Value **args, Value *R);
 int registerVariable(const char *name, ValueFn fn);
 ValueFn findVariable(const char *name);
 
+/* registerFunctionעĺÿж, ûв߶ȡparserе״̬.
+ * ֻɲĺregisterPureFunctionע, İ汾ûб仯ʱٵ */
 int registerFunction(const char *name, ValueFn fn);
+int registerPureFunction(const char *name, ValueFn fn);
 ValueFn findFunction(const char *name);
+/* fnǷregisterPureFunctionע */
+bool isPureFunction(ValueFn fn);
+/* עfnʱõ, ûע᷵0 */
+const char *findVariableName(ValueFn fn);
+const char *findFunctionName(ValueFn fn);
 
 /* ѳõһЩͺ(CLOSE,MA)ʼ */
 void indicatorInit();
@@ -77,6 +154,12 @@ Value *SUB(const Value *X, const Value *Y, Value *R);
 Value *MUL(const Value *X, const Value *Y, Value *R);
 Value *DIV(const Value *X, const Value *Y, Value *R);
 
+/* ں, Aʾ, Nʾ, opΪ('+','-','*','/')
+ * ֤߱鲻Ϊ, ֱֽӵ */
+Value *suanShuYunSuan_AA(const Value *X, const Value *Y, char op, Value *R);
+Value *suanShuYunSuan_AN(const Value *X, double Y, char op, Value *R);
+Value *suanShuYunSuan_NA(double X, const Value *Y, char op, Value *R);
+
 /* R:=REF(X,N); */
 Value *REF(const Value *X, int N, Value *R);
 
@@ -86,12 +169,33 @@ Value *MAX(const Value *X, double M, Value *R);
 /* R:=ABS(X) */
 Value *ABS(const Value *X, Value *R);
 
+/* R:=X, float洢, ڴ, parserSetPrecision.
+ * 洢ֵX뵽float: ֵFLT_MINFLT_MAX֮ʱ2^-24
+ * (FLT_EPSILON/2), Сֵ2^-150, FLT_MAXΪ, NAN.
+ * ֻ洢, ƵȼȻdouble, ۻ */
+Value *FLOAT32(const Value *X, Value *R);
+
 /* R:=HHV(X, N) */
 Value *HHV(const Value *X, int N, Value *R);
 
 /* R:=LLV(X, N) */
 Value *LLV(const Value *X, int N, Value *R);
 
+/* HHV,LLVĵ: пܳΪֵԪصı. ڽstate,
+ * Kߺ͸һKʱ̯O(1) */
+struct ExtremeState {
+	int N;
+	int64_t no; /* еı, 0ʾҪؽ */
+	int head, count, mask;
+	int64_t nos[1]; /* ʵmask+1 */
+};
+int extremeStateSize(int N);
+void extremeStateInit(ExtremeState *st, int N);
+/* bnoenoβĳΪNĴڵ(isMax)Сֵдrs.
+ * СʱֱӱȽ, ûпԼĶҽʱֿ, stеĶ.
+ * stΪ0ʱö */
+void windowExtreme(const Value *X, int N, bool isMax, int64_t bno, int64_t eno, ExtremeState *st, double *rs);
+
 /* MA
 	ؼƶƽ
 	÷MA(X,M)XMռƶƽ */
@@ -0,0 +1,405 @@
+#include "vm.h"
+
+#include <assert.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+
+/* Ŀǰֻ֧x86-64System VԼ(Linux), ƽ̨ɻ */
+#if defined(__x86_64__) && !defined(_WIN32)
+#define TG_JIT_X64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "base.h"
+#include "indicators.h"
+
+namespace tg {
+
+/* VC ûNAN ? */
+#ifndef NAN
+#define NAN (std::numeric_limits<double>::quiet_NaN())
+#endif
+
+/* ------ пʼ ------ */
+
+Value *jitRecurRun(const Value *X, RecurLoopFn loop, Value *R)
+{
+	if (!X || X->size == 0)
+		return R;
+	if (!R) {
+		R = valueNew(X->type);
+		if (!R)
+			return 0;
+	}
+
+	int rsize = X->size;
+	if (!valueResize(R, rsize, X->no)) {
+		valueFree(R);
+		return 0;
+	}
+
+	int64_t xbno = X->no - (X->size-1); /* XеһԪصĿʼ */
+	int64_t bno = R->no ? R->no : xbno; /* ʼ */
+	int nosize = (int)(X->no - bno + 1);
+	int ri = R->size - nosize;
+	assert(ri >= 0);
+	if (ri == 0) { /* һԪûһֵ */
+		R->fs[0] = X->fs[0];
+		ri = 1;
+	}
+	/* RֻĽʱ(valueTrim)ǰroff, ѭXRͬ± */
+	int roff = rsize - R->size;
+	if (ri < R->size)
+		loop(X->fs + roff, R->fs, ri, R->size);
+	R->no = X->no;
+	return R;
+}
+
+void jitFree(JitCode *jit)
+{
+	if (!jit)
+		return;
+#ifdef TG_JIT_X64
+	if (jit->mem)
+		munmap(jit->mem, jit->size);
+#endif
+	free(jit->fns);
+	free(jit);
+}
+
+/* ------ н ------ */
+
+#ifdef TG_JIT_X64
+
+/* ------ ɿʼ ------ */
+
+struct CodeBuf {
+	unsigned char *data;
+	int size;
+	int capacity;
+	bool failed; /* ڴ治 */
+};
+
+static void emit(CodeBuf *cb, const unsigned char *bytes, int n)
+{
+	if (cb->failed)
+		return;
+	if (cb->size + n > cb->capacity) {
+		int capacity = cb->capacity ? cb->capacity * 2 : 256;
+		while (capacity < cb->size + n)
+			capacity *= 2;
+		unsigned char *data = (unsigned char *)realloc(cb->data, capacity);
+		if (!data) {
+			cb->failed = true;
+			return;
+		}
+		cb->data = data;
+		cb->capacity = capacity;
+	}
+	memcpy(cb->data + cb->size, bytes, n);
+	cb->size += n;
+}
+
+#define EMIT(cb, ...) do { \
+	const unsigned char bytes_[] = { __VA_ARGS__ }; \
+	emit(cb, bytes_, sizeof(bytes_)); \
+} while (0)
+
+static void emitImm32(CodeBuf *cb, int32_t v)
+{
+	emit(cb, (const unsigned char *)&v, 4);
+}
+
+/* Ĵ֮SSEָ: prefix 0F op /r */
+static void emitSSE(CodeBuf *cb, unsigned char prefix, unsigned char op, int dst, int src)
+{
+	EMIT(cb, prefix);
+	if (dst >= 8 || src >= 8)
+		EMIT(cb, (unsigned char)(0x40 | (dst >= 8 ? 4 : 0) | (src >= 8 ? 1 : 0)));
+	EMIT(cb, 0x0F, op, (unsigned char)(0xC0 | ((dst & 7) << 3) | (src & 7)));
+}
+
+enum {
+	SSE_MOVAPD = 0x28,
+	SSE_ANDPD = 0x54,
+	SSE_ANDNPD = 0x55,
+	SSE_ORPD = 0x56,
+	SSE_XORPD = 0x57,
+	SSE_ADDSD = 0x58,
+	SSE_MULSD = 0x59,
+	SSE_SUBSD = 0x5C,
+	SSE_DIVSD = 0x5E,
+	SSE_MAXSD = 0x5F,
+};
+
+static void emitPD(CodeBuf *cb, unsigned char op, int dst, int src)
+{
+	emitSSE(cb, 0x66, op, dst, src);
+}
+
+static void emitSD(CodeBuf *cb, unsigned char op, int dst, int src)
+{
+	emitSSE(cb, 0xF2, op, dst, src);
+}
+
+/* xmm = f, rax */
+static void emitLoadConst(CodeBuf *cb, int xmm, double f)
+{
+	uint64_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	EMIT(cb, 0x48, 0xB8); /* mov rax, imm64 */
+	emit(cb, (const unsigned char *)&bits, 8);
+	/* movq xmm, rax */
+	EMIT(cb, 0x66, (unsigned char)(xmm >= 8 ? 0x4C : 0x48), 0x0F, 0x6E, (unsigned char)(0xC0 | ((xmm & 7) << 3)));
+}
+
+/* ѭʱתλҪ */
+static int emitJgeForward(CodeBuf *cb)
+{
+	EMIT(cb, 0x0F, 0x8D);
+	emitImm32(cb, 0);
+	return cb->size;
+}
+
+static void patchJump(CodeBuf *cb, int from)
+{
+	if (cb->failed)
+		return;
+	int32_t rel = cb->size - from;
+	memcpy(cb->data + from - 4, &rel, 4);
+}
+
+static void emitJmpBack(CodeBuf *cb, int to)
+{
+	EMIT(cb, 0xE9);
+	emitImm32(cb, to - (cb->size + 4));
+}
+
+/* ڰ16ֽڶ */
+static void emitAlign(CodeBuf *cb)
+{
+	while (!cb->failed && (cb->size & 15))
+		EMIT(cb, 0xCC);
+}
+
+/* Ĵ:
+ * rdi=base, rsi=r, rdx=n, rcx=i, raxʱ
+ * xmm0..xmm7Ϊջ, xmm8xmm11ʱ, xmm9=0, xmm10=NAN */
+static void genFused(CodeBuf *cb, const FusedExpr *fe)
+{
+	emitPD(cb, SSE_XORPD, 9, 9);
+	emitLoadConst(cb, 10, NAN);
+	EMIT(cb, 0x31, 0xC9); /* xor ecx, ecx */
+	int top = cb->size;
+	EMIT(cb, 0x48, 0x39, 0xD1); /* cmp rcx, rdx */
+	int exit = emitJgeForward(cb);
+
+	int sp = 0;
+	for (int k = 0; k < fe->ncode; ++k) {
+		const FusedCode *c = &fe->code[k];
+		switch (c->op) {
+		case FC_LOAD:
+			/* mov rax, [rdi+8*input]; movsd xmm(sp), [rax+rcx*8] */
+			EMIT(cb, 0x48, 0x8B, 0x47, (unsigned char)(8 * c->input));
+			EMIT(cb, 0xF2, 0x0F, 0x10, (unsigned char)((sp << 3) | 4), 0xC8);
+			++sp;
+			break;
+		case FC_CONST:
+			emitLoadConst(cb, sp, c->f);
+			++sp;
+			break;
+		case FC_ADD:
+			emitSD(cb, SSE_ADDSD, sp - 2, sp - 1);
+			--sp;
+			break;
+		case FC_SUB:
+			emitSD(cb, SSE_SUBSD, sp - 2, sp - 1);
+			--sp;
+			break;
+		case FC_MUL:
+			emitSD(cb, SSE_MULSD, sp - 2, sp - 1);
+			--sp;
+			break;
+		case FC_DIV:
+			/* Ϊ0ʱΪNAN: x = (x/y & mask) | (NAN & ~mask), mask = y!=0 */
+			emitPD(cb, SSE_MOVAPD, 8, sp - 1);
+			EMIT(cb, 0xF2, 0x45, 0x0F, 0xC2, 0xC1, 0x04); /* cmpneqsd xmm8, xmm9 */
+			emitSD(cb, SSE_DIVSD, sp - 2, sp - 1);
+			emitPD(cb, SSE_ANDPD, sp - 2, 8);
+			emitPD(cb, SSE_MOVAPD, 11, 8);
+			emitPD(cb, SSE_ANDNPD, 11, 10);
+			emitPD(cb, SSE_ORPD, sp - 2, 11);
+			--sp;
+			break;
+		case FC_MAX:
+			/* maxsd x > f ? x : f, MAXһ */
+			emitLoadConst(cb, 8, c->f);
+			emitSD(cb, SSE_MAXSD, sp - 1, 8);
+			break;
+		case FC_ABS: {
+			double mask;
+			uint64_t bits = 0x7FFFFFFFFFFFFFFFull;
+			memcpy(&mask, &bits, sizeof(mask));
+			emitLoadConst(cb, 8, mask);
+			emitPD(cb, SSE_ANDPD, sp - 1, 8);
+			break;
+		}
+		}
+	}
+	assert(sp == 1);
+
+	EMIT(cb, 0xF2, 0x0F, 0x11, 0x04, 0xCE); /* movsd [rsi+rcx*8], xmm0 */
+	EMIT(cb, 0x48, 0xFF, 0xC1); /* inc rcx */
+	emitJmpBack(cb, top);
+	patchJump(cb, exit);
+	EMIT(cb, 0xC3); /* ret */
+}
+
+/* Ĵ:
+ * rdi=x, rsi=r, rdx=begin, rcx=end, r8=i
+ * xmm0=ǰֵ, xmm1=һֵ, xmm2ʱ, xmm3=a, xmm4=b, xmm5=c
+ * ˳EMA,SMAͬ: (x*a + y*b) / c */
+static void genRecur(CodeBuf *cb, double a, double b, double c)
+{
+	emitLoadConst(cb, 3, a);
+	emitLoadConst(cb, 4, b);
+	emitLoadConst(cb, 5, c);
+	EMIT(cb, 0x49, 0x89, 0xD0); /* mov r8, rdx */
+	EMIT(cb, 0xF2, 0x42, 0x0F, 0x10, 0x4C, 0xC6, 0xF8); /* movsd xmm1, [rsi+r8*8-8] */
+	int top = cb->size;
+	EMIT(cb, 0x49, 0x39, 0xC8); /* cmp r8, rcx */
+	int exit = emitJgeForward(cb);
+	EMIT(cb, 0xF2, 0x42, 0x0F, 0x10, 0x04, 0xC7); /* movsd xmm0, [rdi+r8*8] */
+	emitSD(cb, SSE_MULSD, 0, 3);
+	emitPD(cb, SSE_MOVAPD, 2, 1);
+	emitSD(cb, SSE_MULSD, 2, 4);
+	emitSD(cb, SSE_ADDSD, 0, 2);
+	emitSD(cb, SSE_DIVSD, 0, 5);
+	EMIT(cb, 0xF2, 0x42, 0x0F, 0x11, 0x04, 0xC6); /* movsd [rsi+r8*8], xmm0 */
+	emitPD(cb, SSE_MOVAPD, 1, 0);
+	EMIT(cb, 0x49, 0xFF, 0xC0); /* inc r8 */
+	emitJmpBack(cb, top);
+	patchJump(cb, exit);
+	EMIT(cb, 0xC3); /* ret */
+}
+
+/* ------ ɽ ------ */
+
+/* һָ */
+struct JitEntry {
+	int instr;
+	int offset; /* ڴеλ */
+};
+
+int programJit(Program *prog)
+{
+	if (prog->jit)
+		return 0;
+
+	CodeBuf cb;
+	memset(&cb, 0, sizeof(cb));
+	Array entries;
+	arrayInit(&entries, sizeof(JitEntry), 16);
+
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		const Instr *ins = (const Instr *)arrayGet(&prog->instrs, i);
+		int offset = cb.size;
+		switch (ins->op) {
+		case OP_FUSED:
+			genFused(&cb, (const FusedExpr *)arrayGet(&prog->fused, ins->n));
+			break;
+		case OP_EMA: /* Y = (X*2 + Y'*(M-1)) / (M+1) */
+			if (ins->n < 0)
+				continue;
+			genRecur(&cb, 2.0, ins->n - 1, ins->n + 1);
+			break;
+		case OP_SMA: /* Y = (X*M + Y'*(N-M)) / N */
+			if (ins->n <= 0 || ins->m < 0)
+				continue;
+			genRecur(&cb, ins->m, ins->n - ins->m, ins->n);
+			break;
+		default: /* ָȻ */
+			continue;
+		}
+		emitAlign(&cb);
+		JitEntry *e = (JitEntry *)arrayAdd(&entries);
+		if (!e) {
+			cb.failed = true;
+			break;
+		}
+		e->instr = i;
+		e->offset = offset;
+	}
+
+	int ret = -1;
+	JitCode *jit = 0;
+	if (cb.failed)
+		goto out;
+	if (entries.size == 0) {
+		ret = 0;
+		goto out;
+	}
+
+	jit = (JitCode *)malloc(sizeof(*jit));
+	if (!jit)
+		goto out;
+	memset(jit, 0, sizeof(*jit));
+	jit->fns = (void **)malloc(sizeof(void *) * entries.size);
+	if (!jit->fns)
+		goto out;
+	{
+		long page = sysconf(_SC_PAGESIZE);
+		jit->size = (cb.size + page - 1) / page * page;
+		void *mem = mmap(0, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+			goto out;
+		jit->mem = (unsigned char *)mem;
+		memcpy(jit->mem, cb.data, cb.size);
+		if (mprotect(jit->mem, jit->size, PROT_READ | PROT_EXEC))
+			goto out;
+	}
+
+	/* ȫɹ滻ָ */
+	for (int i = 0; i < entries.size; ++i) {
+		const JitEntry *e = (const JitEntry *)arrayGet(&entries, i);
+		Instr *ins = (Instr *)arrayGet(&prog->instrs, e->instr);
+		jit->fns[i] = jit->mem + e->offset;
+		if (ins->op == OP_FUSED) {
+			ins->op = OP_JIT_FUSED;
+			ins->m = i;
+		} else {
+			ins->op = OP_JIT_RECUR;
+			ins->b = i;
+		}
+	}
+	jit->nfns = entries.size;
+	prog->jit = jit;
+	jit = 0;
+	ret = entries.size;
+	debug("JIT%dָ,%dֽ\n", ret, cb.size);
+
+out:
+	if (ret < 0)
+		warn("JITʧ,ʹֽ\n");
+	jitFree(jit);
+	free(cb.data);
+	arrayFree(&entries);
+	return ret;
+}
+
+#else
+
+int programJit(Program *prog)
+{
+	(void)prog;
+	return 0;
+}
+
+#endif
+
+}
@@ -0,0 +1,221 @@
+#include "vm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+
+namespace tg {
+
+/* ------ û忪ʼ ------ */
+
+/* мֻڼָһȡָ֮, ڲص
+ * Էͬһڴ, RSIеCLOSE-LCSMAԺͲҪ.
+ * õڴᱻм, ֻмܹ:
+ *   ָֻȡ, ԼϴεĽ(Ԫ);
+ *   ȡָֻȡϴεıſʼԪ(Ԫ͵).
+ * REFֱڴ, HHV,LLV,MAĴҪȡǰԪ,  */
+
+/* ֻԪ */
+static bool isElementwise(const Instr *ins)
+{
+	switch (ins->op) {
+	case OP_ARITH_AA:
+	case OP_ARITH_AN:
+	case OP_ARITH_NA:
+	case OP_MAX:
+	case OP_ABS:
+	case OP_FUSED:
+	case OP_JIT_FUSED:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* ָĵjֻȡӦԪ */
+static bool readsTail(const Program *prog, const Instr *ins, int j)
+{
+	switch (ins->op) {
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_ARITH_AA:
+	case OP_ARITH_AN:
+	case OP_ARITH_NA:
+	case OP_MAX:
+	case OP_ABS:
+	case OP_EMA:
+	case OP_SMA:
+	case OP_JIT_RECUR:
+	case OP_FLOAT32:
+		return true;
+	case OP_RSI: /* X, ״̬ */
+	case OP_DIF:
+		return j == 0;
+	case OP_FUSED:
+	case OP_JIT_FUSED: {
+		const FusedExpr *fe = (const FusedExpr *)arrayGet((Array *)&prog->fused, ins->n);
+		return fe->shifts[j] == 0;
+	}
+	default:
+		return false;
+	}
+}
+
+int programShareBuffers(Program *prog)
+{
+	int nregs = prog->nregs > 0 ? prog->nregs : 1;
+	prog->regBuf = (int *)malloc(sizeof(int) * nregs);
+	if (!prog->regBuf)
+		return -1;
+	for (int i = 0; i < prog->nregs; ++i)
+		prog->regBuf[i] = -1;
+
+	UseDef ud;
+	if (useDefInit(&ud, prog))
+		return -1;
+	/* ѡ: Ԫõм */
+	unsigned char *cand = (unsigned char *)calloc(nregs, 1);
+	int *bufEnd = (int *)malloc(sizeof(int) * nregs); /* ем󱻶ȡָ */
+	if (!cand || !bufEnd) {
+		free(cand);
+		free(bufEnd);
+		useDefFree(&ud);
+		return -1;
+	}
+	for (int i = 0; i < prog->nregs; ++i) {
+		const Instr *ins = useDefInstr(&ud, prog, i);
+		cand[i] = ins && isElementwise(ins) && ud.uses[i] > 0
+			&& (prog->regFlags[i] & (RF_OWN | RF_CONST | RF_ARRAY | RF_OUTPUT)) == (RF_OWN | RF_ARRAY);
+	}
+	for (int i = 0; i < prog->nstmts; ++i)
+		cand[prog->stmtRegs[i]] = 0;
+	const Instr *instrs = (const Instr *)prog->instrs.data;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		/* ֻĽĲù, programTrimSources. ¼ʱҪͷ
+		 * ʼ(valueRewind), ȡȫԪ, Ҳܹ, ֻ */
+		if (instrs[i].op != OP_FLOAT32 || !instrs[i].n)
+			continue;
+		cand[instrs[i].a] = 0;
+		const Instr *def = useDefInstr(&ud, prog, instrs[i].a);
+		int regs[MAX_ARGC];
+		int n = def ? instrOperands(prog, def, regs) : 0;
+		for (int j = 0; j < n; ++j)
+			cand[regs[j]] = 0;
+	}
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		int regs[MAX_ARGC];
+		int n = instrOperands(prog, &instrs[i], regs);
+		for (int j = 0; j < n; ++j) {
+			if (!readsTail(prog, &instrs[i], j))
+				cand[regs[j]] = 0;
+		}
+	}
+
+	/* ָ˳, һζȡ֮󻺳Ϳճ.
+	 * ȡָĽͬһ, ߶д */
+	int ntemps = 0;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		int dst = instrs[i].dst;
+		if (!cand[dst])
+			continue;
+		int b = 0;
+		while (b < prog->nbufs && bufEnd[b] >= i)
+			++b;
+		if (b == prog->nbufs)
+			prog->nbufs++;
+		bufEnd[b] = ud.user[dst];
+		prog->regBuf[dst] = b;
+		++ntemps;
+	}
+	free(cand);
+	free(bufEnd);
+	useDefFree(&ud);
+
+	if (prog->nbufs > 0) {
+		prog->bufs = (Value **)calloc(prog->nbufs, sizeof(Value *));
+		if (!prog->bufs)
+			return -1;
+		for (int b = 0; b < prog->nbufs; ++b) {
+			prog->bufs[b] = valueNew(VT_ARRAY_DOUBLE);
+			if (!prog->bufs[b])
+				return -1;
+		}
+		debug("%dм%d\n", ntemps, prog->nbufs);
+	}
+	return 0;
+}
+
+/* ------ û ------ */
+
+/* ------ ֻĽʼ ------ */
+
+/* float洢Ᵽһ, ֻOP_FLOAT32ȡdoubleҪȫ,
+ * ÿֻҪϴεıſʼԪ, תͶǰ(valueTrim).
+ * ںҪӺ±, ȡһ */
+static bool writesTail(enum OpCode op)
+{
+	switch (op) {
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_ARITH_AA:
+	case OP_ARITH_AN:
+	case OP_ARITH_NA:
+	case OP_MAX:
+	case OP_ABS:
+	case OP_HHV:
+	case OP_LLV:
+	case OP_MA:
+	case OP_EMA:
+	case OP_SMA:
+	case OP_FUSED:
+	case OP_RSI:
+	case OP_RSV:
+	case OP_DIF:
+	case OP_JIT_FUSED:
+	case OP_JIT_RECUR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int programTrimSources(Program *prog)
+{
+	UseDef ud;
+	if (useDefInit(&ud, prog))
+		return -1;
+	unsigned char *stmt = (unsigned char *)calloc(prog->nregs > 0 ? prog->nregs : 1, 1);
+	if (!stmt) {
+		useDefFree(&ud);
+		return -1;
+	}
+	for (int i = 0; i < prog->nstmts; ++i)
+		stmt[prog->stmtRegs[i]] = 1;
+	int ntrims = 0;
+	Instr *instrs = (Instr *)prog->instrs.data;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		Instr *ins = &instrs[i];
+		if (ins->op != OP_FLOAT32)
+			continue;
+		int src = ins->a;
+		const Instr *def = useDefInstr(&ud, prog, src);
+		ins->n = def && writesTail(def->op) && !stmt[src] && useDefIsTemp(&ud, prog, src, 1)
+			&& (prog->regFlags[src] & (RF_OWN | RF_CONST | RF_ARRAY)) == (RF_OWN | RF_ARRAY);
+		ntrims += ins->n;
+	}
+	free(stmt);
+	useDefFree(&ud);
+	if (ntrims)
+		debug("%dfloat洢ֻdouble\n", ntrims);
+	return 0;
+}
+
+/* ------ ֻĽ ------ */
+
+}
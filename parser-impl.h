@@ -1,6 +1,7 @@
 #ifndef TG_INDICATOR_PARSER_IMPL_H
 #define TG_INDICATOR_PARSER_IMPL_H
 
+#include "indicators.h"
 #include "lexer.h"
 
 namespace tg {
@@ -22,12 +23,12 @@ enum NodeType {
 };
 
 struct Value;
+struct Program;
+struct Plugin;
 
+/* нڵе,鶼Parser::arena, ASTһͷ */
 struct Node {
-#ifndef NDEBUG
 	enum NodeType type;
-#endif
-	void (*clean)(Node *node);
 	Value *(*interp)(Node *node, void *parser); /* еǰڵ */
 };
 
@@ -44,6 +45,8 @@ struct Stmt {
 	String id;
 	enum Token op; /* TK_COLON_EQ/TK_COLON */
 	Node *expr;
+	bool live; /* ǷҪ, parserSetOutputs */
+	bool f32; /* float洢, parserSetPrecision */
 	Value *value;
 };
 
@@ -60,6 +63,8 @@ struct DecimalExpr {
 struct IdExpr {
 	struct Node node;
 	String val;
+	ValueFn fn; /* 󶨵ñ,Ϊ0ʱʹslot */
+	int slot; /* 󶨵Stmt± */
 	Value *value;
 };
 
@@ -73,7 +78,10 @@ struct FuncCall {
 	struct Node node;
 	String id;
 	ExprList *args;
+	ValueFn fn; /* 󶨵ĺ */
+	bool pure; /* fnĽֻɲ, isPureFunction */
 	Value *value;
+	unsigned int seen; /* ϴμʱİ汾֮ͼ1, programRun */
 };
 
 struct BinaryExpr {
@@ -82,6 +90,7 @@ struct BinaryExpr {
 	enum Token op;
 	Node *rhs;
 	Value *value;
+	unsigned int seen;
 };
 
 /* ------ AST ------ */
@@ -100,14 +109,27 @@ public:
 	bool isquit;
 	
 	Formula *ast;
+	Arena arena; /* ASTĽڵ,ֺ */
+	Array values; // Value **, ڵнλ, ͷASTʱvalueFree
+	
+	int mode; /* InterpMode */
+	Program *prog; /* astֽ, ʧʱΪ0 */
+	Plugin *plugin; /* parserLoadPluginصĲ */
 	
 	void *userdata;
+	int64_t barNo; /* ϴʱһKߵı, 0ʾ֪(parserAppendBar) */
+	int64_t lastNo; /* ϴʱһKߵı, 0ʾ֪(parserInvalidateFrom) */
 	
 #ifdef CONFIG_LOG_PARSER
 	int interpDepth; /* LOG_INTERPʱƴӡǰĿհַ */
 #endif
 };
 
+/* ΪnameStmt±,û򷵻-1 */
+int parserFindStmt(Parser *p, const char *name);
+/* ȡvһֵΪֵָ */
+int valueToIndicator(const Value *v, double *outf);
+
 }
 
 #endif
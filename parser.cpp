@@ -4,6 +4,7 @@
 #include <float.h>
 #include <malloc.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -11,12 +12,13 @@
 #include "indicators.h"
 #include "lexer.h"
 #include "parser-impl.h"
+#include "plugin.h"
+#include "vm.h"
 
 namespace tg {
 
 #ifdef CONFIG_LOG_PARSER
 //#define LOG_PARSE
-//#define LOG_CLEAN
 #define LOG_INTERP
 #endif
 
@@ -24,102 +26,39 @@ namespace tg {
 
 /* ------ ASTʼ ------ */
 
-static void nodeFree(Node *node)
-{
-	assert(node);
-	node->clean(node);
-	free(node);
-}
-
-/* ------ cleanʼ ------ */
-
-static void formulaClean(Node *node)
-{
-	Formula *f = (Formula *)node;
-#ifdef LOG_CLEAN
-	info("formulaClean\n");
-#endif
-	for(int i = 0; i < f->stmts.size; ++i) {
-		Stmt **arr = (Stmt **)f->stmts.data;
-		nodeFree((Node *)arr[i]);
-	}
-	arrayFree(&f->stmts);
-}
-
-static void stmtClean(Node *node)
-{
-	Stmt *st = (Stmt *)node;
-#ifdef LOG_CLEAN
-	info("stmtClean\n");
-#endif
-	stringFree(&st->id);
-	if (st->expr) {
-		nodeFree((Node *)st->expr);
-	}
-}
-
-static void intExprClean(Node *node)
-{
-#ifdef LOG_CLEAN
-	info("intExprClean\n");
-#endif
-}
+/* ASTڴÿĴС, һĹʽһ͹ */
+#define AST_ARENA_BLOCK 4096
 
-static void decimalExprClean(Node *node)
+/* ڵ㶼arena, ڵеĽҪͷ */
+static void astFree(Parser *p)
 {
-#ifdef LOG_CLEAN
-	info("decimalExprClean\n");
-#endif
-}
-
-static void idExprClean(Node *node)
-{
-	IdExpr *e = (IdExpr *)node;
-#ifdef LOG_CLEAN
-	info("idExprClean\n");
-#endif
-	stringFree(&e->val);
-}
-
-static void exprListClean(Node *node)
-{
-	ExprList *el = (ExprList *)node;
-#ifdef LOG_CLEAN
-	info("exprListClean\n");
-#endif
-	for (int i = 0; i < el->exprs.size; ++i) {
-		Expr **arr = (Expr **)el->exprs.data;
-		nodeFree((Node *)arr[i]);
+	for (int i = 0; i < p->values.size; ++i) {
+		valueFree(**(Value ***)arrayGet(&p->values, i));
 	}
-	arrayFree(&el->exprs);
+	p->values.size = 0;
+	arenaFree(&p->arena);
+	p->ast = 0;
 }
 
-static void funcCallClean(Node *node)
+/* ڵĽ*slotͷASTʱͷ */
+static bool astOwnValue(Parser *p, Value **slot)
 {
-	FuncCall *e = (FuncCall *)node;
-#ifdef LOG_CLEAN
-	info("funcCallClean\n");
-#endif
-	stringFree(&e->id);
-	nodeFree((Node *)e->args);
+	Value ***v = (Value ***)arrayAdd(&p->values);
+	if (!v)
+		return false;
+	*v = slot;
+	return true;
 }
 
-static void binaryExprClean(Node *node)
+/* ڵ㰴˳, ʱҲȽϼ */
+static void *nodeAlloc(Parser *p, int size, enum NodeType type)
 {
-	BinaryExpr *e = (BinaryExpr *)node;
-#ifdef LOG_CLEAN
-	info("binaryExprClean\n");
-#endif
-	if (e->lhs) {
-		nodeFree((Node *)e->lhs);
-	}
-	if (e->rhs) {
-		nodeFree((Node *)e->rhs);
-	}
+	Node *node = (Node *)arenaAlloc(&p->arena, size);
+	if (node)
+		node->type = type;
+	return node;
 }
 
-/* ------ clean ------ */
-
 /* ------ interpʼ ------ */
 
 #ifdef LOG_INTERP
@@ -131,17 +70,40 @@ static void logInterpPrefix(void *parser)
 }
 #endif
 
-static Value *parserFindVariable(Parser *p, const char *name)
+/* ΪnameStmt±,û򷵻-1 */
+int parserFindStmt(Parser *p, const char *name)
 {
 	assert(p);
+	if (!p->ast) { /* ùʽûAST */
+		const FormulaPlugin *api = p->plugin ? p->plugin->api : 0;
+		for (int i = 0; api && i < api->nstmts; ++i) {
+			if (strcmp(name, api->stmtNames[i]) == 0)
+				return i;
+		}
+		return -1;
+	}
 	for (int i = 0; i < p->ast->stmts.size; ++i) {
 		Stmt **arr = (Stmt **)p->ast->stmts.data;
 		Stmt *st = arr[i];
 		if (strcmp(name, st->id.data) == 0) {
-			return st->value;
+			return i;
 		}
 	}
-	return 0;
+	return -1;
+}
+
+static Value *parserFindVariable(Parser *p, const char *name)
+{
+	if (!p || (!p->ast && !p->plugin))
+		return 0;
+	int i = parserFindStmt(p, name);
+	if (i < 0)
+		return 0;
+	if (p->mode == IM_PLUGIN && p->plugin)
+		return p->plugin->api->stmtValue(p->plugin->state, i);
+	if (p->mode != IM_TREE && p->prog)
+		return programStmtValue(p->prog, i);
+	return ((Stmt **)p->ast->stmts.data)[i]->value;
 }
 
 static Value *formulaInterp(Node *node, void *parser)
@@ -156,6 +118,8 @@ static Value *formulaInterp(Node *node, void *parser)
 #endif
 	for (int i = 0; i < e->stmts.size; ++i) {
 		Stmt **arr = (Stmt **)e->stmts.data;
+		if (!arr[i]->live) /* Ҫм */
+			continue;
 		Node *nd = (Node *)arr[i];
 		nd->interp(nd, parser);
 	}
@@ -227,14 +191,14 @@ static Value *idExprInterp(Node *node, void *parser)
 	logInterpPrefix(parser);
 	rawlog("idExprInterp %s\n", e->val.data);
 #endif
-	ValueFn fn;
-	/* õı */
-	fn = findVariable(e->val.data);
-	if (fn)
-		return fn(parser, 0, 0, 0);
+	/* õı,CLOSE */
+	if (e->fn)
+		return e->fn(parser, 0, 0, 0);
 	
-	/* ʽеı */
-	return parserFindVariable((Parser *)parser, e->val.data);
+	/* ʽеı */
+	assert(e->slot >= 0);
+	Stmt **arr = (Stmt **)((Parser *)parser)->ast->stmts.data;
+	return arr[e->slot]->value;
 }
 
 static Value *exprListInterp(Node *node, void *parser)
@@ -279,9 +243,16 @@ static Value *funcCallInterp(Node *node, void *parser)
 		argc = e->args->exprs.size;
 		args = e->args->values;
 	}
-	ValueFn fn = findFunction(e->id.data);
-	if (fn) {
-		e->value = fn(parser, argc, (const Value **)args, e->value);
+	/* ûб仯ʱ¼, ֻнɲĺ */
+	unsigned int sum = 1;
+	for (int i = 0; i < argc; ++i)
+		sum += valueVersion(args[i]);
+	if (!e->pure || e->seen != sum) {
+		e->seen = sum;
+		assert(e->fn);
+		e->value = e->fn(parser, argc, (const Value **)args, e->value);
+		if (e->value)
+			e->value->version++;
 	}
 #ifdef LOG_INTERP
 	((Parser *)parser)->interpDepth--;
@@ -303,14 +274,20 @@ static Value *binaryExprInterp(Node *node, void *parser)
 	assert(e->lhs && e->rhs);
 	Value *lhs = e->lhs->interp(e->lhs, parser);
 	Value *rhs = e->rhs->interp(e->rhs, parser);
-	switch (e->op) {
-	case TK_ADD: e->value = ADD(lhs, rhs, e->value); break; /* + */
-	case TK_SUB: e->value = SUB(lhs, rhs, e->value); break; /* - */
-	case TK_MUL: e->value = MUL(lhs, rhs, e->value); break; /* * */
-	case TK_DIV: e->value = DIV(lhs, rhs, e->value); break; /* / */
-	default:
-		assert(0);
-		break;
+	unsigned int sum = 1 + valueVersion(lhs) + valueVersion(rhs);
+	if (e->seen != sum) {
+		e->seen = sum;
+		switch (e->op) {
+		case TK_ADD: e->value = ADD(lhs, rhs, e->value); break; /* + */
+		case TK_SUB: e->value = SUB(lhs, rhs, e->value); break; /* - */
+		case TK_MUL: e->value = MUL(lhs, rhs, e->value); break; /* * */
+		case TK_DIV: e->value = DIV(lhs, rhs, e->value); break; /* / */
+		default:
+			assert(0);
+			break;
+		}
+		if (e->value)
+			e->value->version++;
 	}
 #ifdef LOG_INTERP
 	logInterpPrefix(parser);
@@ -324,15 +301,13 @@ static Value *binaryExprInterp(Node *node, void *parser)
 
 /* ------ newʼ ------ */
 
-static Formula *formulaNew(Array *arr)
+static Formula *formulaNew(Parser *p, Array *arr)
 {
-	Formula *fm = (Formula *)malloc(sizeof(*fm));
-	if (!fm)
+	Formula *fm = (Formula *)nodeAlloc(p, sizeof(*fm), NT_FORMULA);
+	if (!fm || arrayMoveToArena(arr, &p->arena)) {
+		arrayFree(arr);
 		return 0;
-#ifndef NDEBUG
-	fm->node.type = NT_FORMULA;
-#endif
-	fm->node.clean = formulaClean;
+	}
 	fm->node.interp = formulaInterp;
 	fm->stmts = *arr;
 #ifndef NDEBUG
@@ -341,100 +316,81 @@ static Formula *formulaNew(Array *arr)
 	return fm;
 }
 
-static Stmt *stmtNew(String *id, enum Token tok, Node *expr)
+static Stmt *stmtNew(Parser *p, String *id, enum Token tok, Node *expr)
 {
-	Stmt *st = (Stmt *)malloc(sizeof(*st));
+	Stmt *st = (Stmt *)nodeAlloc(p, sizeof(*st), NT_STMT);
 	if (!st)
 		return 0;
 	assert(tok == TK_COLON_EQ || tok == TK_COLON);
 	assert(expr);
-#ifndef NDEBUG
-	st->node.type = NT_STMT;
-#endif
 	st->value = 0;
-	st->node.clean = stmtClean;
+	st->live = true;
+	st->f32 = false;
 	st->node.interp = stmtInterp;
 	st->id = *id;
-#ifndef NDEBUG
-	memset(id, 0, sizeof(*id));
-#endif
 	st->op = tok;
 	st->expr = expr;
 	return st;
 }
 
-static IntExpr *intExprNew(int val)
+static IntExpr *intExprNew(Parser *p, int val)
 {
-	IntExpr *e = (IntExpr *)malloc(sizeof(*e));
+	IntExpr *e = (IntExpr *)nodeAlloc(p, sizeof(*e), NT_INT_EXPR);
 	if (!e)
 		return 0;
-#ifndef NDEBUG
-	e->node.type = NT_INT_EXPR;
-#endif
 	e->value = valueNew(VT_INT);
-	if (!e->value) {
-		free(e);
+	if (!e->value || !astOwnValue(p, &e->value)) {
+		valueFree(e->value);
 		return 0;
 	}
 	e->value->i = val;
-	e->node.clean = intExprClean;
 	e->node.interp = intExprInterp;
 	return e;
 }
 
-static DecimalExpr *decimalExprNew(double val)
+static DecimalExpr *decimalExprNew(Parser *p, double val)
 {
-	DecimalExpr *e = (DecimalExpr *)malloc(sizeof(*e));
+	DecimalExpr *e = (DecimalExpr *)nodeAlloc(p, sizeof(*e), NT_DECIMAL_EXPR);
 	if (!e)
 		return 0;
-#ifndef NDEBUG
-	e->node.type = NT_DECIMAL_EXPR;
-#endif
 	e->value = valueNew(VT_DOUBLE);
-	if (!e->value) {
-		free(e);
+	if (!e->value || !astOwnValue(p, &e->value)) {
+		valueFree(e->value);
 		return 0;
 	}
 	e->value->f = val;
-	e->node.clean = decimalExprClean;
 	e->node.interp = decimalExprInterp;
 	return e;
 }
 
-static IdExpr *idExprNew(String *val)
+static IdExpr *idExprNew(Parser *p, String *val)
 {
-	IdExpr *e = (IdExpr *)malloc(sizeof(*e));
+	IdExpr *e = (IdExpr *)nodeAlloc(p, sizeof(*e), NT_ID_EXPR);
 	if (!e)
 		return 0;
-#ifndef NDEBUG
-	e->node.type = NT_ID_EXPR;
-#endif
 	e->value = 0;
-	e->node.clean = idExprClean;
 	e->node.interp = idExprInterp;
 	e->val = *val;
-#ifndef NDEBUG
-	memset(val, 0, sizeof(*val));
-#endif
+	e->fn = 0;
+	e->slot = -1;
 	return e;
 }
 
-static ExprList *exprListNew(Array *arr)
+static ExprList *exprListNew(Parser *p, Array *arr)
 {
-	ExprList *e = (ExprList *)malloc(sizeof(*e));
-	if (!e)
+	ExprList *e = (ExprList *)nodeAlloc(p, sizeof(*e), NT_EXPR_LIST);
+	if (!e || arrayMoveToArena(arr, &p->arena)) {
+		arrayFree(arr);
 		return 0;
-#ifndef NDEBUG
-	e->node.type = NT_EXPR_LIST;
-#endif
-	e->node.clean = exprListClean;
+	}
 	e->node.interp = exprListInterp;
 	e->exprs = *arr;
+	e->values = 0;
 	if (e->exprs.size > 0) {
-		e->values = (Value **)malloc(sizeof(Value *) * e->exprs.size);
-		memset(e->values, 0, sizeof(Value *)*e->exprs.size);
-	} else {
-		e->values = 0;
+		e->values = (Value **)arenaAlloc(&p->arena, sizeof(Value *) * e->exprs.size);
+		if (!e->values)
+			return 0;
+		memset(e->values, 0, sizeof(Value *) * e->exprs.size);
 	}
 #ifndef NDEBUG
 	memset(arr, 0, sizeof(*arr));
@@ -442,39 +398,36 @@ static ExprList *exprListNew(Array *arr)
 	return e;
 }
 
-static FuncCall *funcCallNew(String *id, ExprList *args)
+static FuncCall *funcCallNew(Parser *p, String *id, ExprList *args)
 {
-	FuncCall *e = (FuncCall *)malloc(sizeof(*e));
+	FuncCall *e = (FuncCall *)nodeAlloc(p, sizeof(*e), NT_FUNC_CALL);
 	if (!e)
 		return 0;
-#ifndef NDEBUG
-	e->node.type = NT_FUNC_CALL;
-#endif
-	e->node.clean = funcCallClean;
+	e->value = 0;
+	if (!astOwnValue(p, &e->value))
+		return 0;
 	e->node.interp = funcCallInterp;
 	e->id = *id;
 	e->args = args;
-	e->value = 0;
-#ifndef NDEBUG
-	memset(id, 0, sizeof(*id));
-#endif
+	e->fn = 0;
+	e->pure = false;
+	e->seen = 0;
 	return e;
 }
 
-static BinaryExpr *binaryExprNew(Node *lhs, enum Token op, Node *rhs)
+static BinaryExpr *binaryExprNew(Parser *p, Node *lhs, enum Token op, Node *rhs)
 {
-	BinaryExpr *e = (BinaryExpr *)malloc(sizeof(*e));
+	BinaryExpr *e = (BinaryExpr *)nodeAlloc(p, sizeof(*e), NT_BINARY_EXPR);
 	if (!e)
 		return 0;
-#ifndef NDEBUG
-	e->node.type = NT_BINARY_EXPR;
-#endif
-	e->node.clean = binaryExprClean;
+	e->value = 0;
+	if (!astOwnValue(p, &e->value))
+		return 0;
 	e->node.interp = binaryExprInterp;
 	e->lhs = lhs;
 	e->op = op;
 	e->rhs = rhs;
-	e->value = 0;
+	e->seen = 0;
 	return e;
 }
 
@@ -496,7 +449,17 @@ void *parserNew(void *errdata, int (*handleError)(int lineno, int charpos, int e
 	p->errcount = 0;
 	p->isquit = false;
 	p->ast = 0;
+	arenaInit(&p->arena, AST_ARENA_BLOCK);
+	if (arrayInit(&p->values, sizeof(Value **), 32)) {
+		free(p);
+		return 0;
+	}
+	p->mode = IM_VM;
+	p->prog = 0;
+	p->plugin = 0;
 	p->userdata = 0;
+	p->barNo = 0;
+	p->lastNo = 0;
 #ifdef CONFIG_LOG_PARSER
 	p->interpDepth = 0;
 #endif
@@ -511,9 +474,12 @@ void parserFree(void *p)
 	if (yacc->lex) {
 		lexerFree(yacc->lex);
 	}
-	if (yacc->ast) {
-		nodeFree((Node *)yacc->ast);
+	if (yacc->prog) {
+		programFree(yacc->prog);
 	}
+	pluginFree(yacc->plugin);
+	astFree(yacc);
+	arrayFree(&yacc->values);
 	free(yacc);
 }
 
@@ -528,6 +494,132 @@ static bool handleParserError(Parser *p, int error, const char *errmsg)
 	return false;
 }
 
+/* ------ bindʼ ------ */
+
+/* ɺIdExpr󶨵ñStmt, FuncCall󶨵,
+ * ʱֲٰ. δַ֪-1 */
+
+static int bindNode(Parser *p, Node *node)
+{
+	int ret = 0;
+	switch (node->type) {
+	case NT_ID_EXPR: {
+		IdExpr *e = (IdExpr *)node;
+		e->fn = findVariable(e->val.data);
+		if (!e->fn) {
+			e->slot = parserFindStmt(p, e->val.data);
+			if (e->slot < 0) {
+				char errmsg[128];
+				snprintf(errmsg, sizeof(errmsg), "δ֪ı%s", e->val.data);
+				handleParserError(p, 1, errmsg);
+				return -1;
+			}
+		}
+		break;
+	}
+	case NT_FUNC_CALL: {
+		FuncCall *e = (FuncCall *)node;
+		e->fn = findFunction(e->id.data);
+		e->pure = e->fn && isPureFunction(e->fn);
+		if (!e->fn) {
+			char errmsg[128];
+			snprintf(errmsg, sizeof(errmsg), "δ֪ĺ%s", e->id.data);
+			handleParserError(p, 1, errmsg);
+			ret = -1;
+		}
+		if (e->args && bindNode(p, (Node *)e->args))
+			ret = -1;
+		break;
+	}
+	case NT_EXPR_LIST: {
+		ExprList *e = (ExprList *)node;
+		Node **arr = (Node **)e->exprs.data;
+		for (int i = 0; i < e->exprs.size; ++i) {
+			if (bindNode(p, arr[i]))
+				ret = -1;
+		}
+		break;
+	}
+	case NT_BINARY_EXPR: {
+		BinaryExpr *e = (BinaryExpr *)node;
+		if (bindNode(p, e->lhs))
+			ret = -1;
+		if (bindNode(p, e->rhs))
+			ret = -1;
+		break;
+	}
+	default:
+		break;
+	}
+	return ret;
+}
+
+static int bindFormula(Parser *p)
+{
+	int ret = 0;
+	Stmt **arr = (Stmt **)p->ast->stmts.data;
+	for (int i = 0; i < p->ast->stmts.size; ++i) {
+		if (bindNode(p, arr[i]->expr)) {
+			ret = -1;
+			if (p->isquit)
+				break;
+		}
+	}
+	return ret;
+}
+
+/* ------ bind ------ */
+
+/* ------ 㿪ʼ ------ */
+
+static void markStmtLive(Parser *p, int i);
+
+static void markNodeLive(Parser *p, Node *node)
+{
+	switch (node->type) {
+	case NT_ID_EXPR: {
+		IdExpr *e = (IdExpr *)node;
+		if (!e->fn && e->slot >= 0)
+			markStmtLive(p, e->slot);
+		break;
+	}
+	case NT_FUNC_CALL: {
+		FuncCall *e = (FuncCall *)node;
+		if (e->args)
+			markNodeLive(p, (Node *)e->args);
+		break;
+	}
+	case NT_EXPR_LIST: {
+		ExprList *e = (ExprList *)node;
+		Node **arr = (Node **)e->exprs.data;
+		for (int i = 0; i < e->exprs.size; ++i) {
+			markNodeLive(p, arr[i]);
+		}
+		break;
+	}
+	case NT_BINARY_EXPR: {
+		BinaryExpr *e = (BinaryExpr *)node;
+		markNodeLive(p, e->lhs);
+		markNodeLive(p, e->rhs);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/* iStmtҪ,StmtҲҪ */
+static void markStmtLive(Parser *p, int i)
+{
+	Stmt *st = ((Stmt **)p->ast->stmts.data)[i];
+	if (st->live)
+		return;
+	st->live = true;
+	markNodeLive(p, st->expr);
+}
+
+/* ------  ------ */
+
 static Node *parseExpr(Parser *p);
 
 static ExprList *parseExprList(Parser *p)
@@ -560,8 +652,9 @@ static ExprList *parseExprList(Parser *p)
 #ifdef LOG_PARSE
 		info("õExprList\n");
 #endif
-		return exprListNew(&args);
+		return exprListNew(p, &args);
 	}
+	arrayFree(&args);
 	return 0;
 }
 
@@ -569,8 +662,8 @@ static Node *parseIdOrFuncCall(Parser *p)
 {
 	Node *expr = 0;
 	String id;
-	stringInit(&id, p->toklen);
-	stringAdd(&id, p->tokval, p->toklen);
+	if (stringInitArena(&id, &p->arena, p->tokval, p->toklen))
+		return 0;
 	
 	p->tok = lexerGetToken(p->lex, &p->tokval, &p->toklen);
 	if (p->tok == TK_LP) { // (
@@ -581,7 +674,7 @@ static Node *parseIdOrFuncCall(Parser *p)
 #ifdef LOG_PARSE
 			info("õFuncCall\n");
 #endif
-			expr = (Node *)funcCallNew(&id, arg);
+			expr = (Node *)funcCallNew(p, &id, arg);
 			p->tok = lexerGetToken(p->lex, &p->tokval, &p->toklen);
 		} else {
 			handleParserError(p, 1, "FuncCall,ȱ)");
@@ -590,7 +683,7 @@ static Node *parseIdOrFuncCall(Parser *p)
 #ifdef LOG_PARSE
 		info("õIdExpr\n");
 #endif
-		expr = (Node *)idExprNew(&id);
+		expr = (Node *)idExprNew(p, &id);
 	}
 	return expr;
 }
@@ -605,7 +698,7 @@ static Node *parseUnaryExpr(Parser *p)
 #ifdef LOG_PARSE
 		info("õIntExpr\n");
 #endif
-		expr = (Node *)intExprNew(atoi(p->tokval));
+		expr = (Node *)intExprNew(p, atoi(p->tokval));
 		p->tokval[p->toklen] = ch;
 		p->tok = lexerGetToken(p->lex, &p->tokval, &p->toklen);
 	} else if (p->tok == TK_DECIMAL) {
@@ -614,7 +707,7 @@ static Node *parseUnaryExpr(Parser *p)
 #ifdef LOG_PARSE
 		info("õDecimalExpr\n");
 #endif
-		expr = (Node *)decimalExprNew(atof(p->tokval));
+		expr = (Node *)decimalExprNew(p, atof(p->tokval));
 		p->tokval[p->toklen] = ch;
 		p->tok = lexerGetToken(p->lex, &p->tokval, &p->toklen);
 	} else if (p->tok == TK_ID) { // ID | funcCall
@@ -628,10 +721,7 @@ static Node *parseUnaryExpr(Parser *p)
 #endif
 			p->tok = lexerGetToken(p->lex, &p->tokval, &p->toklen);
 		} else {
-			if (expr) {
-				nodeFree(expr);
-				expr = 0;
-			}
+			expr = 0;
 		}
 	}
 	
@@ -672,12 +762,12 @@ static Node *parseBinaryExpr(Parser *p, Node **lhs, int prec)
 	
 	prec2 = getPrec(p->tok);
 	if (prec2 < 0) {
-		Node *e = (Node *)binaryExprNew(*lhs, op, rhs);
+		Node *e = (Node *)binaryExprNew(p, *lhs, op, rhs);
 		if (e) {
 			return e;
 		}
 	} else if (prec2 <= prec) {
-		Node *newlhs = (Node *)binaryExprNew(*lhs, op, rhs);
+		Node *newlhs = (Node *)binaryExprNew(p, *lhs, op, rhs);
 		if (newlhs) {
 			*lhs = newlhs;
 			return parseBinaryExpr(p, lhs, prec2);
@@ -686,13 +776,12 @@ static Node *parseBinaryExpr(Parser *p, Node **lhs, int prec)
 		Node *newrhs = parseBinaryExpr(p, &rhs, prec2);
 		if (newrhs) {
 			rhs = newrhs;
-			Node *e2 = (Node *)binaryExprNew(*lhs, op, rhs);
+			Node *e2 = (Node *)binaryExprNew(p, *lhs, op, rhs);
 			if (e2) {
 				return e2;
 			}
 		}
 	}
-	nodeFree(rhs);
 	return 0;
 }
 
@@ -710,7 +799,6 @@ static Node *parseExpr(Parser *p)
 #endif
 				expr = e2;
 			} else {
-				nodeFree(expr);
 				expr = 0;
 			}
 		}
@@ -723,9 +811,8 @@ static Stmt *parseStmt(Parser *p)
 	String id;
 	
 	assert(p->tok == TK_ID);
-	if (stringInit(&id, p->toklen))
+	if (stringInitArena(&id, &p->arena, p->tokval, p->toklen))
 		return 0;
-	stringAdd(&id, p->tokval, p->toklen);
 	
 	p->tok = lexerGetToken(p->lex, &p->tokval, &p->toklen);
 	if (p->tok == TK_COLON_EQ || p->tok == TK_COLON) {
@@ -737,7 +824,7 @@ static Stmt *parseStmt(Parser *p)
 #ifdef LOG_PARSE
 				info("õstmt\n");
 #endif
-				return stmtNew(&id, op, expr);
+				return stmtNew(p, &id, op, expr);
 			} else {
 				handleParserError(p, 0, "stmt,ȱ;");
 			}
@@ -745,8 +832,6 @@ static Stmt *parseStmt(Parser *p)
 	} else {
 		handleParserError(p, 1, "stmt,ʶ,ֻ:=:");
 	}
-	
-	stringFree(&id);
 	return 0;
 }
 
@@ -779,7 +864,21 @@ end:
 #ifdef LOG_PARSE
 	info("õformula\n");
 #endif
-	return formulaNew(&stmts);
+	return formulaNew(p, &stmts);
+}
+
+/* ±ֽ, IM_JITʱٱɻ. ʧʱȻԱAST */
+static void parserCompile(Parser *p)
+{
+	programFree(p->prog);
+	p->prog = programCompile(p);
+	if (!p->prog) {
+		warn("ֽʧ,ʹAST\n");
+		return;
+	}
+	/* JITʧʱֵָ֧Ȼֽ */
+	if (p->mode == IM_JIT)
+		programJit(p->prog);
 }
 
 /* Զ½ʱ, ֤뵽ÿparseXXXȻȡһtoken,
@@ -790,8 +889,18 @@ static int parseAST(Parser *p)
 #ifdef LOG_PARSE
 	info("ʼAST\n");
 #endif
+	astFree(p); /* ½ʱͷϴεAST */
 	p->ast = parseFormula(p);
-	return p->ast ? 0 : -1;
+	if (!p->ast) {
+		astFree(p);
+		return -1;
+	}
+	if (bindFormula(p)) {
+		astFree(p);
+		return -1;
+	}
+	parserCompile(p);
+	return 0;
 }
 
 int parserParseFile(void *p, const char *filename)
@@ -851,23 +960,270 @@ end:
 int parserInterp(void *p, void *userdata)
 {
 	Parser *yacc = (Parser *)p;
-	if (!yacc || !yacc->ast)
+	if (!yacc || (!yacc->ast && !yacc->plugin))
 		return -1;
 	assert(yacc->userdata == 0 || yacc->userdata == userdata);
 	yacc->userdata = userdata;
+	yacc->barNo = 0; /* ֪仯, ´ʱ */
+	Quote *q = (Quote *)userdata;
+	yacc->lastNo = q && q->close ? q->close->no : 0;
+	if (yacc->mode == IM_PLUGIN && yacc->plugin)
+		return yacc->plugin->api->run(yacc->plugin->state, yacc);
+	if (yacc->mode != IM_TREE && yacc->prog)
+		return programRun(yacc->prog, yacc);
 	yacc->ast->node.interp((Node *)yacc->ast, p);
 	
 	return 0;
 }
 
-int parserGetIndicator(void *p, const char *name, double *outf)
+/* ASTнڵĽınoʼ¼, noΪ0ʱͷ, lastvalueRewindQuote.
+ * Stmt,ExprListIdExprеǱĽڵĽ(), ޸ */
+static void nodeRewind(Node *node, int64_t no, int64_t last)
+{
+	if (!node)
+		return;
+	switch (node->type) {
+	case NT_FORMULA: {
+		Formula *e = (Formula *)node;
+		for (int i = 0; i < e->stmts.size; ++i)
+			nodeRewind(((Node **)e->stmts.data)[i], no, last);
+		break;
+	}
+	case NT_STMT:
+		nodeRewind(((Stmt *)node)->expr, no, last);
+		break;
+	case NT_EXPR_LIST: {
+		ExprList *e = (ExprList *)node;
+		for (int i = 0; i < e->exprs.size; ++i)
+			nodeRewind(((Node **)e->exprs.data)[i], no, last);
+		break;
+	}
+	case NT_FUNC_CALL: {
+		FuncCall *e = (FuncCall *)node;
+		nodeRewind((Node *)e->args, no, last);
+		if (e->value)
+			valueRewindQuote(e->value, no, last);
+		e->seen = 0;
+		break;
+	}
+	case NT_BINARY_EXPR: {
+		BinaryExpr *e = (BinaryExpr *)node;
+		nodeRewind(e->lhs, no, last);
+		nodeRewind(e->rhs, no, last);
+		if (e->value)
+			valueRewindQuote(e->value, no, last);
+		e->seen = 0;
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/* ASTнڵĽռõֽ, ͬnodeRewindֻFuncCallBinaryExprԼĽ */
+static size_t nodeSeriesBytes(const Node *node)
+{
+	if (!node)
+		return 0;
+	switch (node->type) {
+	case NT_FORMULA: {
+		const Formula *e = (const Formula *)node;
+		size_t bytes = 0;
+		for (int i = 0; i < e->stmts.size; ++i)
+			bytes += nodeSeriesBytes(((Node **)e->stmts.data)[i]);
+		return bytes;
+	}
+	case NT_STMT:
+		return nodeSeriesBytes(((const Stmt *)node)->expr);
+	case NT_EXPR_LIST: {
+		const ExprList *e = (const ExprList *)node;
+		size_t bytes = 0;
+		for (int i = 0; i < e->exprs.size; ++i)
+			bytes += nodeSeriesBytes(((Node **)e->exprs.data)[i]);
+		return bytes;
+	}
+	case NT_FUNC_CALL: {
+		const FuncCall *e = (const FuncCall *)node;
+		return nodeSeriesBytes((const Node *)e->args) + valueSeriesBytes(e->value);
+	}
+	case NT_BINARY_EXPR: {
+		const BinaryExpr *e = (const BinaryExpr *)node;
+		return nodeSeriesBytes(e->lhs) + nodeSeriesBytes(e->rhs) + valueSeriesBytes(e->value);
+	}
+	default:
+		return 0;
+	}
+}
+
+/* зʽĽӱnoʼ¼, noΪ0ʱͷ. ʧܷ-1 */
+static int parserRewind(Parser *p, int64_t no)
+{
+	/* ϴʱ鲻֪ʱֻܴͷ */
+	if (!p->lastNo)
+		no = 0;
+	if (p->ast)
+		nodeRewind((Node *)p->ast, no, p->lastNo);
+	if (p->prog)
+		programRewind(p->prog, no, p->lastNo);
+	if (p->plugin) { /* ļĴ״̬, ֻ´ͷ */
+		void *state = p->plugin->api->create();
+		if (!state)
+			return -1;
+		p->plugin->api->destroy(p->plugin->state);
+		p->plugin->state = state;
+	}
+	return 0;
+}
+
+/* ϴкһKӦno */
+static int parserRunBar(Parser *p, void *userdata, int64_t no)
+{
+	Quote *q = (Quote *)userdata;
+	if (!q || !q->close)
+		return -1;
+	if (p->barNo && q->close->no != no && parserRewind(p, 0))
+		return -1;
+	int ret = parserInterp(p, userdata);
+	p->barNo = ret ? 0 : q->close->no;
+	return ret;
+}
+
+int parserAppendBar(void *p, void *userdata)
+{
+	return parserAppendBars(p, userdata, 1);
+}
+
+int parserAppendBars(void *p, void *userdata, int n)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc || n < 1)
+		return -1;
+	return parserRunBar(yacc, userdata, yacc->barNo + n);
+}
+
+int parserUpdateLastBar(void *p, void *userdata)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc)
+		return -1;
+	return parserRunBar(yacc, userdata, yacc->barNo);
+}
+
+int parserInvalidateFrom(void *p, int64_t no)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc || no < 0)
+		return -1;
+	return parserRewind(yacc, no);
+}
+
+int64_t parserSeriesBytes(void *p)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc)
+		return 0;
+	if (yacc->mode == IM_PLUGIN)
+		return 0;
+	if (yacc->mode != IM_TREE && yacc->prog)
+		return (int64_t)programSeriesBytes(yacc->prog);
+	return (int64_t)nodeSeriesBytes((const Node *)yacc->ast);
+}
+
+int parserLookback(void *p)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc)
+		return 0;
+	if (yacc->prog)
+		return programLookback(yacc->prog);
+	if (yacc->plugin)
+		return yacc->plugin->api->lookback;
+	return 0;
+}
+
+int parserSetOutputs(void *p, const char **names, int count)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc || !yacc->ast)
+		return -1;
+	Stmt **arr = (Stmt **)yacc->ast->stmts.data;
+	int nstmts = yacc->ast->stmts.size;
+	for (int i = 0; names && i < count; ++i) {
+		if (parserFindStmt(yacc, names[i]) < 0)
+			return -1;
+	}
+	for (int i = 0; i < nstmts; ++i) {
+		arr[i]->live = !names;
+	}
+	for (int i = 0; names && i < count; ++i) {
+		markStmtLive(yacc, parserFindStmt(yacc, names[i]));
+	}
+
+	/* ±, Ҫָɾ */
+	if (yacc->prog)
+		parserCompile(yacc);
+	return 0;
+}
+
+int parserSetPrecision(void *p, const char **names, int count, int precision)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc || !yacc->ast || (precision != PREC_DOUBLE && precision != PREC_FLOAT))
+		return -1;
+	Stmt **arr = (Stmt **)yacc->ast->stmts.data;
+	for (int i = 0; names && i < count; ++i) {
+		if (parserFindStmt(yacc, names[i]) < 0)
+			return -1;
+	}
+	for (int i = 0; !names && i < yacc->ast->stmts.size; ++i) {
+		arr[i]->f32 = precision == PREC_FLOAT;
+	}
+	for (int i = 0; names && i < count; ++i) {
+		arr[parserFindStmt(yacc, names[i])]->f32 = precision == PREC_FLOAT;
+	}
+
+	if (yacc->prog)
+		parserCompile(yacc);
+	return 0;
+}
+
+int parserSetInterpMode(void *p, int mode)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc)
+		return -1;
+	if (!yacc->ast && yacc->plugin && mode != IM_PLUGIN) /* ùʽֻв */
+		return -1;
+	if (mode == IM_TREE) {
+		yacc->mode = IM_TREE;
+		return 0;
+	}
+	if (mode == IM_PLUGIN) {
+		if (!yacc->plugin)
+			return -1;
+		yacc->mode = IM_PLUGIN;
+		return 0;
+	}
+	if ((mode == IM_VM || mode == IM_JIT) && yacc->prog) {
+		/* ֽͻ벻ܻ, лʱ± */
+		if (mode != yacc->mode && (mode == IM_JIT || yacc->prog->jit)) {
+			yacc->mode = mode;
+			parserCompile(yacc);
+			return yacc->prog ? 0 : -1;
+		}
+		yacc->mode = mode;
+		return 0;
+	}
+	return -1;
+}
+
+int valueToIndicator(const Value *v, double *outf)
 {
 	int ret = -1;
 	double f = -DBL_MAX;
-	Value *v = parserFindVariable((Parser *)p, name);
 	if (v) {
 		ret = 0;
-		if (v->type == VT_ARRAY_DOUBLE) {
+		if (v->type == VT_ARRAY_DOUBLE || v->type == VT_ARRAY_FLOAT) {
 			f = valueGet(v, v->size-1);
 		} else if (v->type == VT_INT) {
 			f = v->i;
@@ -882,4 +1238,14 @@ int parserGetIndicator(void *p, const char *name, double *outf)
 	return ret;
 }
 
+int parserGetIndicator(void *p, const char *name, double *outf)
+{
+	return valueToIndicator(parserFindVariable((Parser *)p, name), outf);
+}
+
+unsigned int parserIndicatorVersion(void *p, const char *name)
+{
+	return valueVersion(parserFindVariable((Parser *)p, name));
+}
+
 }
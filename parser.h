@@ -1,6 +1,8 @@
 #ifndef TG_INDICATOR_PARSER_H
 #define TG_INDICATOR_PARSER_H
 
+#include <stdint.h>
+
 namespace tg {
 
 /* ﷨
@@ -36,13 +38,72 @@ namespace tg {
 /* handleError0ʾ, 1ʾж */
 void *parserNew(void *errdata, int (*handleError)(int lineno, int charpos, int error, const char *errmsg, void *errdata));
 void parserFree(void *p);
+/* ùʽname(plugin.h), Ҫ, ֻIM_PLUGIN. ûʽ0 */
+void *parserNewBuiltin(const char *name, void *errdata, int (*handleError)(int lineno, int charpos, int error, const char *errmsg, void *errdata));
 
 int parserParseFile(void *p, const char *filename);
 int parserParse(void *p, const char *str, int len);
 
 int parserInterp(void *p, void *userdata);
 
+/* K, userdataQuote(quoteAppendBar).
+ * һKߺparserAppendBar, иһKߺparserUpdateLastBar.
+ * ֮ǰKߵĽ͵״̬Ѿȷ, һKʱÿڵֻһԪ,
+ * 붼ûб仯Ľڵ㲻(ֻCLOSE仯ʱHHV(HIGH,N)).
+ * ϴеνӲʱ(¼)ͷ */
+int parserAppendBar(void *p, void *userdata);
+int parserUpdateLastBar(void *p, void *userdata);
+/* һnK(quoteAppendBars), ֻһ, ÿںһμnµĽ.
+ * nparserAppendBarĽһ, ڶK */
+int parserAppendBars(void *p, void *userdata, int n);
+/* бno֮K߱޸(˼ǰK)ʱ,
+ * ´ʱnoʼ¼, ֮ǰĽ͵״̬, noľ.
+ * ҪĽѾʱ(quoteSetKeep)Ͳʽͷ. ʧܷ-1 */
+int parserInvalidateFrom(void *p, int64_t no);
+/* ʱҪK(quoteSetKeep), ôͱȫĽһ.
+ * ɹʽREFλƺHHV,LLV,MAĴھ̬õ, ȷʱ0 */
+int parserLookback(void *p);
+
+/* ֻnamesеָı, StmtȲҲڴ.
+ * namesΪ0ʱȫStmt(Ĭ). δַ֪-1 */
+int parserSetOutputs(void *p, const char **names, int count);
+
+/* Ĵ洢 */
+enum Precision {
+	PREC_DOUBLE, /* Ĭ */
+	PREC_FLOAT, /* float洢, ڴ, Ȼdouble. indicators.hеFLOAT32 */
+};
+/* namesеָ(namesΪ0ʱΪȫ)precision洢, ֻӰparserGetIndicatorȶĽ,
+ * ʽЩָĵطȻʹdoubleĽ. ֻֽJITʽ֧, Ľ
+ * Ϊοʵdouble. ֱREFָ겻ռڴ, Ȼdouble.
+ * δַ֪-1 */
+int parserSetPrecision(void *p, const char **names, int count, int precision);
+/* мռõֽ(), . Ľ״̬, 0 */
+int64_t parserSeriesBytes(void *p);
+
+/* еķʽ */
+enum InterpMode {
+	IM_TREE, /* AST,Ϊοʵ */
+	IM_VM, /* бֽ,ĬϷʽ */
+	IM_JIT, /* ԪEMA/SMAɻ, ͬIM_VM. ֻ֧x86-64 */
+	IM_PLUGIN, /* parserGenerateCppɵĲ, parserLoadPluginл */
+};
+/* леķʽ,ɹ0 */
+int parserSetInterpMode(void *p, int mode);
+
 int parserGetIndicator(void *p, const char *name, double *outf);
+/* ָİ汾, ¼ʱ. 붼ûб仯Ľڵ㲻, 汾Ҳ,
+ * ߿Ծݴûб仯ָ. Ҳûмʱ0 */
+unsigned int parserIndicatorVersion(void *p, const char *name);
+
+/* ѹʽC++дfilename, nameΪ. ǰָ,
+ * ɶ̬ķplugin.h */
+int parserGenerateCpp(void *p, const char *name, const char *filename);
+/* ͬparserGenerateCpp, ɵĴΪùʽͳһ, nameֻĸֺ» */
+int parserGenerateBuiltin(void *p, const char *name, const char *filename);
+/* زлIM_PLUGIN. ʧܻʽʱ-1,
+ * Ȼԭķʽ */
+int parserLoadPlugin(void *p, const char *filename);
 
 /* ------ Parser ------ */
 
@@ -0,0 +1,147 @@
+#include "plugin.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Ŀǰֻ֧dlopen, ƽ̨زʧ, Ȼ */
+#ifndef _WIN32
+#define TG_PLUGIN_DL
+#include <dlfcn.h>
+#endif
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+#include "parser-impl.h"
+
+namespace tg {
+
+/* ------ زʼ ------ */
+
+Plugin *pluginLoad(const char *filename)
+{
+#ifdef TG_PLUGIN_DL
+	void *handle = dlopen(filename, RTLD_NOW | RTLD_LOCAL);
+	if (!handle) {
+		warn("ز%sʧ: %s\n", filename, dlerror());
+		return 0;
+	}
+	FormulaPluginEntry entry = (FormulaPluginEntry)dlsym(handle, PLUGIN_ENTRY);
+	const FormulaPlugin *api = entry ? entry() : 0;
+	if (!api || api->version != PLUGIN_VERSION) {
+		warn("%sİ汾һ\n", filename);
+		dlclose(handle);
+		return 0;
+	}
+	Plugin *pl = pluginNew(api);
+	if (!pl) {
+		warn("%sʼʧ\n", filename);
+		dlclose(handle);
+		return 0;
+	}
+	pl->handle = handle;
+	return pl;
+#else
+	warn("ǰƽֲ̨֧%s\n", filename);
+	return 0;
+#endif
+}
+
+Plugin *pluginNew(const FormulaPlugin *api)
+{
+	if (!api || api->version != PLUGIN_VERSION)
+		return 0;
+	Plugin *pl = (Plugin *)malloc(sizeof(*pl));
+	if (!pl)
+		return 0;
+	pl->handle = 0;
+	pl->api = api;
+	pl->state = api->create();
+	if (!pl->state) {
+		free(pl);
+		return 0;
+	}
+	return pl;
+}
+
+void pluginFree(Plugin *pl)
+{
+	if (!pl)
+		return;
+	pl->api->destroy(pl->state);
+#ifdef TG_PLUGIN_DL
+	if (pl->handle)
+		dlclose(pl->handle);
+#endif
+	free(pl);
+}
+
+/* Ҫͬһʽָͬ */
+static bool pluginMatch(Parser *p, const FormulaPlugin *api)
+{
+	Stmt **arr = (Stmt **)p->ast->stmts.data;
+	if (api->nstmts != p->ast->stmts.size)
+		return false;
+	for (int i = 0; i < api->nstmts; ++i) {
+		if (strcmp(api->stmtNames[i], arr[i]->id.data) != 0)
+			return false;
+	}
+	Program *prog = programCompile(p);
+	if (!prog)
+		return false;
+	bool same = programFingerprint(prog) == api->fingerprint;
+	programFree(prog);
+	return same;
+}
+
+int parserLoadPlugin(void *p, const char *filename)
+{
+	Parser *yacc = (Parser *)p;
+	if (!yacc || !yacc->ast || !filename)
+		return -1;
+	Plugin *pl = pluginLoad(filename);
+	if (!pl)
+		return -1;
+	if (!pluginMatch(yacc, pl->api)) {
+		warn("%s빫ʽһ\n", filename);
+		pluginFree(pl);
+		return -1;
+	}
+	pluginFree(yacc->plugin);
+	yacc->plugin = pl;
+	yacc->mode = IM_PLUGIN;
+	return 0;
+}
+
+void *parserNewBuiltin(const char *name, void *errdata, int (*handleError)(int lineno, int charpos, int error, const char *errmsg, void *errdata))
+{
+	const BuiltinFormula *bf = findBuiltinFormula(name);
+	if (!bf)
+		return 0;
+	Parser *p = (Parser *)parserNew(errdata, handleError);
+	if (!p)
+		return 0;
+	p->plugin = pluginNew(bf->entry());
+	if (!p->plugin) {
+		parserFree(p);
+		return 0;
+	}
+	p->mode = IM_PLUGIN;
+	return p;
+}
+
+bool builtinFormulaIsCurrent(const BuiltinFormula *bf)
+{
+	Parser *p = (Parser *)parserNew(0, 0);
+	if (!p)
+		return false;
+	bool same = parserParse(p, bf->formula, strlen(bf->formula)) == 0
+		&& pluginMatch(p, bf->entry());
+	parserFree(p);
+	return same;
+}
+
+/* ------ ز ------ */
+
+}
@@ -0,0 +1,68 @@
+#ifndef TG_INDICATOR_PLUGIN_H
+#define TG_INDICATOR_PLUGIN_H
+
+#include "indicators.h"
+#include "vm.h"
+
+namespace tg {
+
+/* ------ ʼ ------ */
+
+/* parserGenerateCppѹʽC++, ɶ̬ǲ:
+ *   c++ -O3 -fPIC -shared -I<Ŀ¼> -o rsi.so rsi.cpp
+ * ֱӵеں, ʱҪ(-rdynamic).
+ * PLUGIN_ENTRY, FormulaPlugin */
+
+#define PLUGIN_VERSION 4
+#define PLUGIN_ENTRY "tgFormulaPlugin"
+
+struct FormulaPlugin {
+	int version; /* PLUGIN_VERSION, һʱʹ */
+	const char *name;
+	unsigned int fingerprint; /* ʱָֽ, programFingerprint */
+	int nstmts;
+	const char *const *stmtNames; /* 빫ʽStmt˳һ */
+	void *(*create)(); /* ʧܷ0 */
+	void (*destroy)(void *state);
+	int (*run)(void *state, void *parser);
+	Value *(*stmtValue)(void *state, int i); /* iStmtĽ, ûмʱΪ0 */
+	int lookback; /* ʱprogramLookback, parserLookback */
+};
+
+typedef const FormulaPlugin *(*FormulaPluginEntry)();
+
+/* غĲ */
+struct Plugin {
+	void *handle; /* dlopenķֵ */
+	const FormulaPlugin *api;
+	void *state;
+};
+
+/* ʧܷ0 */
+Plugin *pluginLoad(const char *filename);
+/* ʹӵеapi, ʧܷ0 */
+Plugin *pluginNew(const FormulaPlugin *api);
+void pluginFree(Plugin *pl);
+
+/* ùʽ: parserGenerateBuiltinbuiltin-XXX.cpp, ͳһ,
+ * ʱҪʽ, ʽдʱɾͻʧ */
+struct BuiltinFormula {
+	const char *name;
+	const char *formula; /* ʱʹõĹʽ */
+	const FormulaPlugin *(*entry)();
+};
+
+/* еùʽ, count */
+const BuiltinFormula *builtinFormulas(int *count);
+const BuiltinFormula *findBuiltinFormula(const char *name);
+/* ɵĴڵĹʽͱһ */
+bool builtinFormulaIsCurrent(const BuiltinFormula *bf);
+
+/* ָֽ, ͬһʽĽͬ. زʱжϲǷʽ */
+unsigned int programFingerprint(Program *prog);
+
+/* ------  ------ */
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "vm.h"
+
+#include <assert.h>
+#include <float.h>
+#include <malloc.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+
+namespace tg {
+
+/* ------ ʼ ------ */
+
+/* ֻȫı任:
+ * 1. x*1, x/1, x-0 ֱʹx. x+0: xΪ-0ʱ+0
+ * 2. c+x, c*x  x+c, x*c, ŻֻҪһʽ
+ * 3. x/c 1/cԾȷʾ(cΪ2)ʱ x*(1/c)
+ * ĵı, . (x*a)*bҲϲx*(a*b), ʹa,bΪ2,
+ * x*aȻ߳Ϊǹ */
+
+/* f2, ˳fֻıָ */
+static bool isPowerOfTwo(double f)
+{
+	if (f == 0 || !isValueValid(f))
+		return false;
+	int e;
+	double m = frexp(f, &e);
+	return (m == 0.5 || m == -0.5) && e > DBL_MIN_EXP && e < DBL_MAX_EXP;
+}
+
+struct Simplifier {
+	Program *prog;
+	int *alias; /* Ĵ滻ĸĴ */
+	int nchanged;
+};
+
+/* ǲָ */
+static bool isIdentity(const Instr *ins)
+{
+	if (ins->op != OP_ARITH_AN)
+		return false;
+	switch (ins->n) {
+	case '*':
+	case '/':
+		return ins->f == 1;
+	case '-':
+		return ins->f == 0;
+	default:
+		return false;
+	}
+}
+
+/* 滻ļĴ */
+static void renameOperands(Simplifier *s, Instr *ins)
+{
+	switch (ins->op) {
+	case OP_VAR:
+		break;
+	case OP_CALL:
+	case OP_FUSED:
+	case OP_JIT_FUSED:
+	case OP_RSI:
+	case OP_RSV:
+	case OP_DIF: {
+		int *operands = (int *)s->prog->operands.data;
+		for (int j = 0; j < ins->b; ++j) {
+			operands[ins->a + j] = s->alias[operands[ins->a + j]];
+		}
+		break;
+	}
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_ARITH_AA:
+		ins->a = s->alias[ins->a];
+		ins->b = s->alias[ins->b];
+		break;
+	default:
+		ins->a = s->alias[ins->a];
+		break;
+	}
+}
+
+/* ָҪ, reg. StmtҲĳʹreg */
+static void replaceWith(Simplifier *s, Instr *ins, int reg)
+{
+	Program *prog = s->prog;
+	s->alias[ins->dst] = reg;
+	if (prog->regFlags[ins->dst] & RF_OUTPUT) {
+		for (int i = 0; i < prog->nstmts; ++i) {
+			if (prog->stmtRegs[i] == ins->dst)
+				prog->stmtRegs[i] = reg;
+		}
+		prog->regFlags[reg] |= RF_OUTPUT;
+		prog->regFlags[ins->dst] &= ~RF_OUTPUT;
+	}
+	s->nchanged++;
+}
+
+static void simplifyInstr(Simplifier *s, Instr *ins)
+{
+	/* c+x, c*x  x+c, x*c Ľȫһ */
+	if (ins->op == OP_ARITH_NA && (ins->n == '+' || ins->n == '*')) {
+		ins->op = OP_ARITH_AN;
+		s->nchanged++;
+	}
+	if (ins->op != OP_ARITH_AN)
+		return;
+
+	if (ins->n == '/' && isPowerOfTwo(ins->f) && isPowerOfTwo(1 / ins->f)) {
+		ins->n = '*';
+		ins->f = 1 / ins->f;
+		s->nchanged++;
+	}
+
+	if (isIdentity(ins))
+		replaceWith(s, ins, ins->a);
+}
+
+int programSimplify(Program *prog)
+{
+	Simplifier s;
+	s.prog = prog;
+	s.nchanged = 0;
+	s.alias = (int *)malloc(sizeof(int) * (prog->nregs > 0 ? prog->nregs : 1));
+	if (!s.alias)
+		return -1;
+	for (int i = 0; i < prog->nregs; ++i) {
+		s.alias[i] = i;
+	}
+
+	/* ˳, Ѿ */
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		Instr *ins = (Instr *)arrayGet(&prog->instrs, i);
+		renameOperands(&s, ins);
+		simplifyInstr(&s, ins);
+	}
+
+	free(s.alias);
+	if (s.nchanged == 0)
+		return 0;
+	debug("%d\n", s.nchanged);
+	/* 滻ָʹ */
+	return programRemoveDead(prog);
+}
+
+/* ------  ------ */
+
+}
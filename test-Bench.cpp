@@ -0,0 +1,413 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* ܲ, еԪԽȫK:
+ * 1. ÿں˴ͷ
+ * 2. ͬڵMAHHV, ÿ¼ڱȽ
+ * 3. ÿʽKط, ֱAST,ֽJIT
+ * 4. ܳʱͣ
+ * 5. ֮ǰKߺparserInvalidateFrom¼, ͷȽ
+ * 6. K, parserAppendBarsһбȽ
+ * 7. ظͷŹʽ */
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+static const int KERNEL_REPEAT = 200;
+static const int WINDOW_ROUNDS = 3; /* ͷȡ, ٲ */
+static const int REPLAY_REPEAT = 3;
+static const int REPLAY_START = 100; /* ͵Ԫһ, һЩK */
+static const int CORRECT_BACK = 50; /* ô֮ǰK */
+static const int PARSE_REPEAT = 2000;
+
+static const char *RSI = ""
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSI2:SMA(MAX(CLOSE-LC,0),12,1)/SMA(ABS(CLOSE-LC),12,1)*100;\n"
+	"RSI3:SMA(MAX(CLOSE-LC,0),24,1)/SMA(ABS(CLOSE-LC),24,1)*100;";
+
+static const char *KDJ = ""
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"J:3*K-2*D;";
+
+static const char *MACD = ""
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MACD:(DIF-DEA)*2;";
+
+static const char *ARITH = ""
+	"MID:(HIGH+LOW)/2;\n"
+	"AMP:(HIGH-LOW)/REF(CLOSE,1)*100/2*1+0;\n"
+	"PCT:(CLOSE/OPEN-1)*100/4;";
+
+static const char *FORMULAS[][2] = {
+	{ "RSI", RSI },
+	{ "KDJ", KDJ },
+	{ "MACD", MACD },
+	{ "ARITH", ARITH },
+};
+
+static double elapsed(clock_t begin)
+{
+	return (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+enum BenchKernel {
+	BK_ADD, BK_MUL_N, BK_DIV_N, BK_DIV, BK_MAX, BK_ABS,
+	BK_HHV, BK_LLV, BK_MA, BK_EMA, BK_SMA,
+	BK_ALL
+};
+
+static const char *KERNEL_NAMES[] = {
+	"ADD", "MUL_N", "DIV_N", "DIV", "MAX", "ABS",
+	"HHV", "LLV", "MA", "EMA", "SMA",
+};
+
+static Value *runKernel(int k, Value *R)
+{
+	switch (k) {
+	case BK_ADD: return suanShuYunSuan_AA(q->high, q->low, '+', R);
+	case BK_MUL_N: return suanShuYunSuan_AN(q->close, 100, '*', R);
+	case BK_DIV_N: return suanShuYunSuan_AN(q->close, 3, '/', R);
+	case BK_DIV: return suanShuYunSuan_AA(q->close, q->open, '/', R);
+	case BK_MAX: return MAX(q->close, 10, R);
+	case BK_ABS: return ABS(q->close, R);
+	case BK_HHV: return HHV(q->high, 20, R);
+	case BK_LLV: return LLV(q->low, 20, R);
+	case BK_MA: return MA(q->close, 20, R);
+	case BK_EMA: return EMA(q->close, 12, R);
+	case BK_SMA: return SMA(q->close, 6, 1, R);
+	default: return R;
+	}
+}
+
+static void benchKernels()
+{
+	for (int k = 0; k < BK_ALL; ++k) {
+		Value *R = 0;
+		clock_t begin = clock();
+		for (int i = 0; i < KERNEL_REPEAT; ++i) {
+			if (R)
+				R->no = 0; /* ͷ */
+			R = runKernel(k, R);
+		}
+		info(" ں%-8s %d %.3f\n", KERNEL_NAMES[k], KERNEL_REPEAT, elapsed(begin));
+		valueFree(R);
+	}
+}
+
+static const int WINDOWS[] = { 5, 10, 20, 40, 60, 120, 250 };
+
+typedef Value *(*WindowFn)(const Value *X, int M, Value *R);
+
+/* ԭMA: ÿԴ, MAȽ */
+static Value *windowMA(const Value *X, int M, Value *R)
+{
+	if (X->size < M)
+		return R;
+	if (!R)
+		R = valueNew(VT_ARRAY_DOUBLE);
+	int rsize = X->size - M + 1;
+	valueExtend(R, rsize);
+	R->size = rsize;
+	int64_t first = X->no - X->size + M;
+	for (int64_t kno = R->no > first ? R->no : first; kno <= X->no; ++kno) {
+		int xi = (int)(kno - (X->no - X->size + 1));
+		double sum = 0;
+		for (int j = xi - M + 1; j <= xi; ++j)
+			sum += X->fs[j];
+		R->fs[kno - first] = sum / M;
+	}
+	R->no = X->no;
+	return R;
+}
+
+/* ԭHHV: ÿȽϴеԪ */
+static Value *windowHHV(const Value *X, int M, Value *R)
+{
+	if (X->size < M)
+		return R;
+	if (!R)
+		R = valueNew(VT_ARRAY_DOUBLE);
+	int rsize = X->size - M + 1;
+	valueExtend(R, rsize);
+	R->size = rsize;
+	int64_t first = X->no - X->size + M;
+	for (int64_t kno = R->no > first ? R->no : first; kno <= X->no; ++kno) {
+		int xi = (int)(kno - (X->no - X->size + 1));
+		double res = X->fs[xi];
+		for (int j = xi - M + 1; j < xi; ++j) {
+			if (X->fs[j] > res)
+				res = X->fs[j];
+		}
+		R->fs[kno - first] = res;
+	}
+	R->no = X->no;
+	return R;
+}
+
+/* ͷK߼ */
+static void benchWindow(WindowFn fn, int M, double *full, double *tick)
+{
+	Value *R = 0;
+	for (int k = 0; k < WINDOW_ROUNDS; ++k) {
+		clock_t begin = clock();
+		for (int i = 0; i < KERNEL_REPEAT; ++i) {
+			if (R)
+				R->no = 0;
+			R = fn(q->close, M, R);
+		}
+		double ms = elapsed(begin);
+		if (k == 0 || ms < *full)
+			*full = ms;
+	}
+	valueFree(R);
+	R = 0;
+
+	Value *X = valueNew(VT_ARRAY_DOUBLE);
+	valueExtend(X, q->close->size);
+	clock_t begin = clock();
+	for (int i = 0; i < q->close->size; ++i) {
+		valueAdd(X, q->close->fs[i]);
+		R = fn(X, M, R);
+	}
+	*tick = elapsed(begin);
+	valueFree(R);
+	valueFree(X);
+}
+
+/* ͬڵںfnԭrefȽ */
+static void benchWindows(const char *name, WindowFn fn, WindowFn ref, const char *refName)
+{
+	for (unsigned i = 0; i < sizeof(WINDOWS)/sizeof(WINDOWS[0]); ++i) {
+		double full, tick, rfull, rtick;
+		benchWindow(fn, WINDOWS[i], &full, &tick);
+		benchWindow(ref, WINDOWS[i], &rfull, &rtick);
+		info(" %s(CLOSE,%d) ͷ%d %.3f(%s %.3f) %d %.3f(%s %.3f)\n",
+			name, WINDOWS[i], KERNEL_REPEAT, full, refName, rfull, q->close->size, tick, refName, rtick);
+		/* СҲҪѡԭ㷨 */
+		if (full > rfull)
+			warn("%s(CLOSE,%d)ͷ%s\n", name, WINDOWS[i], refName);
+	}
+}
+
+static const int GROWTH_BARS = 1 << 22;
+static volatile double sink; /* ƵĽܱŻ */
+
+/* һӵGROWTH_BARSK߲EMA, ͳЩKߵʱ.
+ * 븴(reallocԭʱ)Ƚ */
+static void benchGrowth()
+{
+	Value *X = valueNew(VT_ARRAY_DOUBLE);
+	Value *R = 0;
+	valueExtend(X, 1024);
+	int grows = 0;
+	double maxTick = 0, maxCopy = 0;
+	clock_t total = clock();
+	for (int i = 0; i < GROWTH_BARS; ++i) {
+		bool grow = X->size == X->capacity || (R && R->size == R->capacity);
+		clock_t begin = grow ? clock() : 0;
+		valueAdd(X, q->close->fs[i % q->close->size]);
+		R = EMA(X, 12, R);
+		if (!grow)
+			continue;
+		double ms = elapsed(begin);
+		maxTick = ms > maxTick ? ms : maxTick;
+		++grows;
+
+		begin = clock();
+		double *copy = (double *)malloc(sizeof(double) * X->capacity);
+		if (copy) {
+			memcpy(copy, X->fs, sizeof(double) * X->size);
+			sink += copy[X->size - 1];
+			free(copy);
+		}
+		ms = elapsed(begin);
+		maxCopy = ms > maxCopy ? ms : maxCopy;
+	}
+	info(" %d %.3f %d ʱ%.3f(%.3f)\n",
+		GROWTH_BARS, elapsed(total), grows, maxTick, maxCopy);
+	/* mremap·ҳ, ӦԶڸ */
+	if (maxTick > maxCopy)
+		warn("ʱȸ黹\n");
+	valueFree(X);
+	valueFree(R);
+}
+
+/* Kط, غ */
+static double replay(const char *formula, int mode)
+{
+	Quote bars;
+	bars.open = valueNew(VT_ARRAY_DOUBLE);
+	bars.high = valueNew(VT_ARRAY_DOUBLE);
+	bars.low = valueNew(VT_ARRAY_DOUBLE);
+	bars.close = valueNew(VT_ARRAY_DOUBLE);
+	valueExtend(bars.open, q->close->size);
+	valueExtend(bars.high, q->close->size);
+	valueExtend(bars.low, q->close->size);
+	valueExtend(bars.close, q->close->size);
+
+	void *parser = parserNew(0, testHandleError);
+	parserParse(parser, formula, strlen(formula));
+	parserSetInterpMode(parser, mode);
+
+	clock_t begin = 0;
+	for (int i = 0; i < q->close->size; ++i) {
+		valueAdd(bars.open, q->open->fs[i]);
+		valueAdd(bars.high, q->high->fs[i]);
+		valueAdd(bars.low, q->low->fs[i]);
+		valueAdd(bars.close, q->close->fs[i]);
+		if (i + 1 < REPLAY_START)
+			continue;
+		if (i + 1 == REPLAY_START)
+			begin = clock();
+		parserInterp(parser, &bars);
+	}
+	double ms = elapsed(begin);
+
+	parserFree(parser);
+	valueFree(bars.open);
+	valueFree(bars.high);
+	valueFree(bars.low);
+	valueFree(bars.close);
+	return ms;
+}
+
+static void benchFormulas()
+{
+	for (unsigned i = 0; i < sizeof(FORMULAS)/sizeof(FORMULAS[0]); ++i) {
+		double tree = 0, vm = 0, jit = 0;
+		for (int j = 0; j < REPLAY_REPEAT; ++j) {
+			tree += replay(FORMULAS[i][1], IM_TREE);
+			vm += replay(FORMULAS[i][1], IM_VM);
+			jit += replay(FORMULAS[i][1], IM_JIT);
+		}
+		info(" ط%-8s %dK AST %.3f ֽ %.3f JIT %.3f\n",
+			FORMULAS[i][0], q->close->size - REPLAY_START + 1,
+			tree / REPLAY_REPEAT, vm / REPLAY_REPEAT, jit / REPLAY_REPEAT);
+	}
+}
+
+/* ӱnoʼ¼KERNEL_REPEAT, noΪ0ʱͷ, غ */
+static double recompute(void *parser, int64_t no)
+{
+	clock_t begin = clock();
+	for (int i = 0; i < KERNEL_REPEAT; ++i) {
+		parserInvalidateFrom(parser, no);
+		parserInterp(parser, q);
+	}
+	return elapsed(begin);
+}
+
+static void benchCorrection()
+{
+	for (unsigned i = 0; i < sizeof(FORMULAS)/sizeof(FORMULAS[0]); ++i) {
+		void *parser = parserNew(0, testHandleError);
+		parserParse(parser, FORMULAS[i][1], strlen(FORMULAS[i][1]));
+		parserInterp(parser, q);
+		double part = recompute(parser, q->close->no - CORRECT_BACK);
+		double full = recompute(parser, 0);
+		info(" %d֮ǰK %-8s ¼ %.4f ͷ %.4f\n",
+			CORRECT_BACK, FORMULAS[i][0], part / KERNEL_REPEAT, full / KERNEL_REPEAT);
+		parserFree(parser);
+	}
+}
+
+/* REPLAY_STARTKʱһ, ֮Kһβ(batchΪtrue), غ */
+static double catchUp(const char *formula, bool batch)
+{
+	Quote bars;
+	Value **vs[] = { &bars.open, &bars.high, &bars.low, &bars.close };
+	const Value *src[] = { q->open, q->high, q->low, q->close };
+	for (int k = 0; k < 4; ++k) {
+		*vs[k] = valueNew(VT_ARRAY_DOUBLE);
+		valueExtend(*vs[k], q->close->size);
+		valueAddN(*vs[k], src[k]->fs, REPLAY_START);
+	}
+	void *parser = parserNew(0, testHandleError);
+	parserParse(parser, formula, strlen(formula));
+	parserAppendBars(parser, &bars, REPLAY_START);
+
+	clock_t begin = clock();
+	int n = q->close->size - REPLAY_START;
+	if (batch) {
+		quoteAppendBars(&bars, q->open->fs + REPLAY_START, q->high->fs + REPLAY_START,
+			q->low->fs + REPLAY_START, q->close->fs + REPLAY_START, n);
+		parserAppendBars(parser, &bars, n);
+	} else {
+		for (int i = REPLAY_START; i < q->close->size; ++i) {
+			quoteAppendBar(&bars, q->open->fs[i], q->high->fs[i], q->low->fs[i], q->close->fs[i]);
+			parserAppendBar(parser, &bars);
+		}
+	}
+	double ms = elapsed(begin);
+
+	parserFree(parser);
+	for (int k = 0; k < 4; ++k)
+		valueFree(*vs[k]);
+	return ms;
+}
+
+static void benchCatchUp()
+{
+	if (q->close->size <= REPLAY_START)
+		return;
+	for (unsigned i = 0; i < sizeof(FORMULAS)/sizeof(FORMULAS[0]); ++i) {
+		double batch = 0, bars = 0;
+		for (int j = 0; j < REPLAY_REPEAT; ++j) {
+			batch += catchUp(FORMULAS[i][1], true);
+			bars += catchUp(FORMULAS[i][1], false);
+		}
+		info(" %dK %-8s һ %.3f  %.3f\n",
+			q->close->size - REPLAY_START, FORMULAS[i][0],
+			batch / REPLAY_REPEAT, bars / REPLAY_REPEAT);
+	}
+}
+
+static void benchParse()
+{
+	for (unsigned i = 0; i < sizeof(FORMULAS)/sizeof(FORMULAS[0]); ++i) {
+		clock_t begin = clock();
+		for (int j = 0; j < PARSE_REPEAT; ++j) {
+			void *parser = parserNew(0, testHandleError);
+			parserParse(parser, FORMULAS[i][1], strlen(FORMULAS[i][1]));
+			parserFree(parser);
+		}
+		info(" %-8s %.4f\n", FORMULAS[i][0], elapsed(begin) / PARSE_REPEAT);
+	}
+}
+
+void testBenchInit()
+{
+}
+
+void testBench()
+{
+}
+
+void testBenchShutdown()
+{
+	info("ʼܲ\n");
+	if (q && q->close->size > 0) {
+		benchKernels();
+		benchWindows("MA", MA, windowMA, "");
+		benchWindows("HHV", HHV, windowHHV, "ֱӱȽ");
+		benchFormulas();
+		benchGrowth();
+		benchCorrection();
+		benchCatchUp();
+	}
+	benchParse();
+	info("ܲ\n\n");
+}
@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "base.h"
+#include "parser.h"
+#include "plugin.h"
+
+#include "test-base.h"
+
+/* ùʽҪ, ʽֽеĽȽ.
+ * ʽ߱Żı, ùʽҪinterp builtin */
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+#define MAX_BUILTINS 16
+
+static void *vmParsers[MAX_BUILTINS];
+static void *builtinParsers[MAX_BUILTINS];
+static int nbuiltins = 0;
+static int errcount = 0;
+
+void testBuiltinInit()
+{
+	info("ʼԪBuiltin\n");
+
+	const BuiltinFormula *bfs = builtinFormulas(&nbuiltins);
+	if (nbuiltins > MAX_BUILTINS)
+		nbuiltins = MAX_BUILTINS;
+	for (int i = 0; i < nbuiltins; ++i) {
+		vmParsers[i] = parserNew(0, testHandleError);
+		parserParse(vmParsers[i], bfs[i].formula, strlen(bfs[i].formula));
+		builtinParsers[i] = parserNewBuiltin(bfs[i].name, 0, testHandleError);
+		if (!builtinParsers[i]) {
+			warn("ùʽ%sʧ\n", bfs[i].name);
+			++errcount;
+		} else if (parserSetInterpMode(builtinParsers[i], IM_VM) == 0) {
+			warn("ùʽ%sлзʽ\n", bfs[i].name);
+			++errcount;
+		}
+		if (!builtinFormulaIsCurrent(&bfs[i])) {
+			warn("ùʽ%sҪ\n", bfs[i].name);
+			++errcount;
+		}
+	}
+	if (parserNewBuiltin("NOT_EXIST", 0, testHandleError)) {
+		warn("˲ڵùʽ\n");
+		++errcount;
+	}
+}
+
+void testBuiltin()
+{
+	const BuiltinFormula *bfs = builtinFormulas(0);
+	for (int i = 0; i < nbuiltins; ++i) {
+		if (!builtinParsers[i])
+			continue;
+		if (parserInterp(vmParsers[i], q) || parserInterp(builtinParsers[i], q)) {
+			warn("ùʽ%sʧ\n", bfs[i].name);
+			++errcount;
+			continue;
+		}
+		const FormulaPlugin *api = bfs[i].entry();
+		for (int j = 0; j < api->nstmts; ++j) {
+			double f1, f2;
+			int r1 = parserGetIndicator(vmParsers[i], api->stmtNames[j], &f1);
+			int r2 = parserGetIndicator(builtinParsers[i], api->stmtNames[j], &f2);
+			if (r1 != r2 || !sameValue(f1, f2)) {
+				warn("ùʽһ %s.%s %f %f\n", bfs[i].name, api->stmtNames[j], f1, f2);
+				++errcount;
+			}
+		}
+	}
+}
+
+void testBuiltinShutdown()
+{
+	for (int i = 0; i < nbuiltins; ++i) {
+		parserFree(vmParsers[i]);
+		parserFree(builtinParsers[i]);
+		vmParsers[i] = builtinParsers[i] = 0;
+	}
+	if (errcount) {
+		error("ùʽֽһ%d\n", errcount);
+	}
+	info("ԪBuiltin\n\n");
+}
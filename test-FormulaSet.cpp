@@ -0,0 +1,96 @@
+#include <assert.h>
+#include <string.h>
+
+#include "base.h"
+#include "formula-set.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* ʽһ, ÿʽеĽȽ */
+static const char *FOUMULAS[] = {
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSI2:SMA(MAX(CLOSE-LC,0),12,1)/SMA(ABS(CLOSE-LC),12,1)*100;",
+
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"J:3*K-2*D;",
+
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MACD:(DIF-DEA)*2;",
+
+	/* Ĺʽкܶͬӱʽ */
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"LC:=REF(CLOSE,1);\n"
+	"UP:SMA(MAX(CLOSE-LC,0),6,1);\n"
+	"WR:(HHV(HIGH,9)-CLOSE)/(HHV(HIGH,9)-LLV(LOW,9))*100;",
+};
+
+static const char *NAMES[] = {
+	"RSI1", "RSI2", "K", "D", "J", "DIF", "DEA", "MACD", "UP", "WR",
+};
+
+#define NFORMULA ((int)(sizeof(FOUMULAS)/sizeof(FOUMULAS[0])))
+
+using namespace tg;
+namespace tg { struct Quote ; }
+
+extern tg::Quote *q;
+
+static void *parsers[NFORMULA];
+static void *set = 0;
+static int errcount = 0;
+
+void testFormulaSetInit()
+{
+	info("ʼԪFormulaSet\n");
+
+	set = formulaSetNew();
+	for (int i = 0; i < NFORMULA; ++i) {
+		parsers[i] = parserNew(0, testHandleError);
+		parserParse(parsers[i], FOUMULAS[i], strlen(FOUMULAS[i]));
+		if (formulaSetAdd(set, parsers[i])) {
+			warn("FormulaSet빫ʽ%dʧ\n", i);
+			++errcount;
+		}
+	}
+}
+
+void testFormulaSet()
+{
+	if (formulaSetInterp(set, q)) {
+		warn("FormulaSetʧ\n");
+		++errcount;
+		return;
+	}
+	for (int i = 0; i < NFORMULA; ++i) {
+		parserInterp(parsers[i], q);
+		for (unsigned k = 0; k < sizeof(NAMES)/sizeof(NAMES[0]); ++k) {
+			double f1, f2;
+			int r1 = parserGetIndicator(parsers[i], NAMES[k], &f1);
+			int r2 = formulaSetGetIndicator(set, parsers[i], NAMES[k], &f2);
+			if (r1 != r2 || !sameValue(f1, f2)) {
+				warn("FormulaSetһ %d %s %f %f\n", i, NAMES[k], f1, f2);
+				++errcount;
+			}
+		}
+	}
+}
+
+void testFormulaSetShutdown()
+{
+	formulaSetFree(set);
+	set = 0;
+	for (int i = 0; i < NFORMULA; ++i) {
+		parserFree(parsers[i]);
+		parsers[i] = 0;
+	}
+	if (errcount) {
+		error("FormulaSet뵥еĽһ%d\n", errcount);
+	}
+	info("ԪFormulaSet\n\n");
+}
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* HHV,LLVKõм, ֱӱȽϴеԪرȽ.
+ * ʱٴͷһ, ֿ */
+static const char *FOUMULA = ""
+	"H3:HHV(HIGH,3);\n"
+	"L3:LLV(LOW,3);\n"
+	"H20:HHV(HIGH,20);\n"
+	"L20:LLV(LOW,20);\n"
+	"H90:HHV(HIGH-LOW,90);\n"
+	"L90:LLV(CLOSE,90);\n"
+	"RSV:(CLOSE-LLV(LOW,30))/(HHV(HIGH,30)-LLV(LOW,30))*100;";
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+static void *parser = 0;
+static void *treeParser = 0;
+static int errcount = 0;
+
+/* ԵxiԪؽβNԪصֵ */
+static double windowExtreme(const Value *X, const Value *Y, int xi, int N, bool isMax)
+{
+	double res = Y ? X->fs[xi] - Y->fs[xi] : X->fs[xi];
+	for (int i = xi - N + 1; i < xi; ++i) {
+		double f = Y ? X->fs[i] - Y->fs[i] : X->fs[i];
+		if (isMax ? f > res : f < res)
+			res = f;
+	}
+	return res;
+}
+
+static void checkExtreme(const char *name, double expect)
+{
+	double f1, f2;
+	if (parserGetIndicator(parser, name, &f1) || parserGetIndicator(treeParser, name, &f2)) {
+		warn("HHVûн %s\n", name);
+		++errcount;
+		return;
+	}
+	if (f1 != expect || f2 != expect) {
+		warn("HHVһ %s %f %f %f\n", name, f1, f2, expect);
+		++errcount;
+	}
+}
+
+void testHHVInit()
+{
+	info("ʼԪHHV\n");
+	info("ʽΪ\n%s\n", FOUMULA);
+
+	parser = parserNew(0, testHandleError);
+	parserParse(parser, FOUMULA, strlen(FOUMULA));
+	treeParser = parserNew(0, testHandleError);
+	parserParse(treeParser, FOUMULA, strlen(FOUMULA));
+	parserSetInterpMode(treeParser, IM_TREE);
+}
+
+void testHHV()
+{
+	if (parserInterp(parser, q) || parserInterp(treeParser, q)) {
+		warn("HHVʧ\n");
+		++errcount;
+		return;
+	}
+	int last = q->close->size - 1;
+	checkExtreme("H3", windowExtreme(q->high, 0, last, 3, true));
+	checkExtreme("L3", windowExtreme(q->low, 0, last, 3, false));
+	checkExtreme("H20", windowExtreme(q->high, 0, last, 20, true));
+	checkExtreme("L20", windowExtreme(q->low, 0, last, 20, false));
+	checkExtreme("H90", windowExtreme(q->high, q->low, last, 90, true));
+	checkExtreme("L90", windowExtreme(q->close, 0, last, 90, false));
+	double ll = windowExtreme(q->low, 0, last, 30, false);
+	double hh = windowExtreme(q->high, 0, last, 30, true);
+	double rsv = (q->close->fs[last] - ll) / (hh - ll) * 100;
+	double f;
+	parserGetIndicator(parser, "RSV", &f);
+	if (fabs(f - rsv) > 1e-9 * fabs(rsv)) {
+		warn("HHVһ RSV %f %f\n", f, rsv);
+		++errcount;
+	}
+}
+
+/* ͷ */
+static void checkFull(int N)
+{
+	Value *H = HHV(q->high, N, 0);
+	Value *L = LLV(q->low, N, 0);
+	if (!H || !L || H->size != q->high->size - N + 1 || L->size != H->size) {
+		warn("HHVͷʧ %d\n", N);
+		++errcount;
+	} else {
+		for (int i = 0; i < H->size; ++i) {
+			int xi = i + N - 1;
+			if (H->fs[i] != windowExtreme(q->high, 0, xi, N, true)
+					|| L->fs[i] != windowExtreme(q->low, 0, xi, N, false)) {
+				warn("HHVͷĽһ %d %d\n", N, i);
+				++errcount;
+				break;
+			}
+		}
+	}
+	valueFree(H);
+	valueFree(L);
+}
+
+void testHHVShutdown()
+{
+	static const int WINDOWS[] = { 1, 3, 20, 90, 250 };
+	for (unsigned i = 0; i < sizeof(WINDOWS)/sizeof(WINDOWS[0]); ++i) {
+		checkFull(WINDOWS[i]);
+	}
+	parserFree(parser);
+	parserFree(treeParser);
+	parser = 0;
+	treeParser = 0;
+	if (errcount) {
+		error("HHVֱӱȽϵĽһ%d\n", errcount);
+	}
+	info("ԪHHV\n\n");
+}
@@ -0,0 +1,204 @@
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* ֻparserLookbackK, еĽ뱣ȫqϵĽȽ,
+ * ڴ治. һܹһKߺparserAppendBarsһ,
+ * ĴС1keep. ÿһЩKparserInvalidateFrom
+ * ǰ漸¼, ûб仯, ҲҪͱȫһ */
+static const char *FOUMULA = ""
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MA20:MA(CLOSE,20);\n"
+	"X:=REF(MA(CLOSE,5),3);\n"
+	"Y:HHV(X,10)-LLV(HIGH-LOW,30);";
+
+static const char *NAMES[] = {
+	"RSI1", "K", "D", "DIF", "DEA", "MA20", "Y",
+};
+
+/* ʽlookback */
+struct LookbackCase {
+	const char *formula;
+	int lookback;
+};
+
+static const LookbackCase CASES[] = {
+	{ "A:CLOSE+1;", 2 },
+	{ "A:MA(CLOSE,20);", 21 },
+	{ "A:REF(CLOSE,5);", 7 },
+	{ "A:EMA(REF(CLOSE,2),5)-CLOSE;", 4 },
+	{ "A:HHV(REF(MA(CLOSE,5),3),10);", 18 },
+	{ FOUMULA, 31 },
+};
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+static Quote *bq = 0; /* ֻkeepKߵ */
+static int keep = 0;
+static void *parsers[TM_ALL];
+static Quote *batchq = 0; /* һһKߵ, Ҳֻkeep */
+static void *batchParsers[TM_ALL];
+static int batchNext = 0; /* qһûмӵbatchqеK */
+static int batchSize = 1;
+static Quote *invq = 0; /* K߲ʱ¼, Ҳֻkeep */
+static void *invParsers[TM_ALL];
+static int calls = 0;
+static void *qParser = 0;
+static int errcount = 0;
+
+/* ÿôKparserInvalidateFromǰ¼һ */
+#define INVALIDATE_INTERVAL 7
+#define INVALIDATE_BACK 3
+
+/* qϵĽȽ */
+static void compare(void *p, const char *what, int mode)
+{
+	for (unsigned j = 0; j < sizeof(NAMES)/sizeof(NAMES[0]); ++j) {
+		double f1, f2;
+		parserGetIndicator(p, NAMES[j], &f1);
+		parserGetIndicator(qParser, NAMES[j], &f2);
+		if (!sameValue(f1, f2)) {
+			warn("ֻ%dK%sĽһ %s %s %.12f %.12f\n", keep, what, TEST_MODE_NAMES[mode], NAMES[j], f1, f2);
+			++errcount;
+		}
+	}
+}
+
+void testLookbackInit()
+{
+	info("ʼԪLookback\n");
+	info("ʽΪ\n%s\n", FOUMULA);
+
+	for (unsigned i = 0; i < sizeof(CASES)/sizeof(CASES[0]); ++i) {
+		void *p = testNewParser(CASES[i].formula, TM_VM);
+		int n = parserLookback(p);
+		if (n != CASES[i].lookback) {
+			warn("lookbackȷ %s %d %d\n", CASES[i].formula, n, CASES[i].lookback);
+			++errcount;
+		}
+		parserFree(p);
+	}
+
+	qParser = testNewParser(FOUMULA, TM_VM);
+	keep = parserLookback(qParser);
+	bq = quoteCopy(q, keep);
+	batchq = quoteCopy(q, keep);
+	invq = quoteCopy(q, keep);
+	batchNext = q->close->size;
+	for (int m = 0; m < TM_ALL; ++m) {
+		parsers[m] = testNewParser(FOUMULA, m);
+		if (parsers[m])
+			parserInterp(parsers[m], bq);
+		batchParsers[m] = testNewParser(FOUMULA, m);
+		if (batchParsers[m])
+			parserInterp(batchParsers[m], batchq);
+		invParsers[m] = testNewParser(FOUMULA, m);
+		if (invParsers[m])
+			parserInterp(invParsers[m], invq);
+	}
+}
+
+/* qһK, Ȱ̼ٸΪʱļ۸ */
+static void appendBar(Quote *d, void **ps)
+{
+	int i = q->close->size - 1;
+	double o = q->open->fs[i];
+	quoteAppendBar(d, o, o, o, o);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (ps[m])
+			parserAppendBar(ps[m], d);
+	}
+	quoteUpdateLastBar(d, o, q->high->fs[i], q->low->fs[i], q->close->fs[i]);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (ps[m])
+			parserUpdateLastBar(ps[m], d);
+	}
+}
+
+/* 1INVALIDATE_BACKK֮ǰ¼, Ҫͽ */
+static void invalidate()
+{
+	int back = calls / INVALIDATE_INTERVAL % INVALIDATE_BACK + 1;
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (!invParsers[m])
+			continue;
+		if (parserInvalidateFrom(invParsers[m], invq->close->no - back)
+				|| parserUpdateLastBar(invParsers[m], invq)) {
+			warn("parserInvalidateFromʧ %s\n", TEST_MODE_NAMES[m]);
+			++errcount;
+		}
+		compare(invParsers[m], "¼", m);
+	}
+}
+
+/* ܹbatchSizeKߺһμbatchq */
+static void appendBatch()
+{
+	int n = q->close->size - batchNext;
+	if (n < batchSize)
+		return;
+	quoteAppendBars(batchq, q->open->fs + batchNext, q->high->fs + batchNext,
+		q->low->fs + batchNext, q->close->fs + batchNext, n);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (!batchParsers[m])
+			continue;
+		if (parserAppendBars(batchParsers[m], batchq, n)) {
+			warn("parserAppendBarsʧ %s\n", TEST_MODE_NAMES[m]);
+			++errcount;
+		}
+		compare(batchParsers[m], "һ", m);
+	}
+	batchNext = q->close->size;
+	batchSize = batchSize % (keep * 2 + 5) + 7;
+}
+
+void testLookback()
+{
+	appendBar(bq, parsers);
+	appendBar(invq, invParsers);
+
+	parserInterp(qParser, q);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (parsers[m])
+			compare(parsers[m], "", m);
+	}
+	appendBatch();
+	if (++calls % INVALIDATE_INTERVAL == 0)
+		invalidate();
+	if (bq->close->size > keep * 2) {
+		warn("ĴС%d: %d\n", keep * 2, bq->close->size);
+		++errcount;
+	}
+}
+
+void testLookbackShutdown()
+{
+	for (int m = 0; m < TM_ALL; ++m) {
+		parserFree(parsers[m]);
+		parsers[m] = 0;
+		parserFree(batchParsers[m]);
+		batchParsers[m] = 0;
+		parserFree(invParsers[m]);
+		invParsers[m] = 0;
+	}
+	parserFree(qParser);
+	qParser = 0;
+	quoteFree(bq);
+	quoteFree(batchq);
+	quoteFree(invq);
+	bq = batchq = invq = 0;
+	if (errcount) {
+		error("ֻlookbackKߵĽһ%d\n", errcount);
+	}
+	info("ԪLookback\n\n");
+}
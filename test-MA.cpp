@@ -0,0 +1,82 @@
+#include <math.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* MAK߻, ֱӶԴͱȽ */
+static const char *FOUMULA = ""
+	"MA5:MA(CLOSE,5);\n"
+	"MA20:MA(CLOSE,20);\n"
+	"MA60:MA(HIGH-LOW,60);";
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+static void *parser = 0;
+static void *treeParser = 0;
+static int errcount = 0;
+
+/* һKߵMվֵ */
+static double windowMA(const Value *X, const Value *Y, int M)
+{
+	double sum = 0;
+	for (int i = X->size - M; i < X->size; ++i) {
+		sum += Y ? X->fs[i] - Y->fs[i] : X->fs[i];
+	}
+	return sum / M;
+}
+
+static void checkMA(const char *name, double expect)
+{
+	double f1, f2;
+	if (parserGetIndicator(parser, name, &f1) || parserGetIndicator(treeParser, name, &f2)) {
+		warn("MAûн %s\n", name);
+		++errcount;
+		return;
+	}
+	if (fabs(f1 - expect) > 1e-9 * fabs(expect) || f1 != f2) {
+		warn("MAһ %s %.12f %.12f %.12f\n", name, f1, f2, expect);
+		++errcount;
+	}
+}
+
+void testMAInit()
+{
+	info("ʼԪMA\n");
+	info("ʽΪ\n%s\n", FOUMULA);
+
+	parser = parserNew(0, testHandleError);
+	parserParse(parser, FOUMULA, strlen(FOUMULA));
+	treeParser = parserNew(0, testHandleError);
+	parserParse(treeParser, FOUMULA, strlen(FOUMULA));
+	parserSetInterpMode(treeParser, IM_TREE);
+}
+
+void testMA()
+{
+	if (parserInterp(parser, q) || parserInterp(treeParser, q)) {
+		warn("MAʧ\n");
+		++errcount;
+		return;
+	}
+	checkMA("MA5", windowMA(q->close, 0, 5));
+	checkMA("MA20", windowMA(q->close, 0, 20));
+	checkMA("MA60", windowMA(q->high, q->low, 60));
+}
+
+void testMAShutdown()
+{
+	parserFree(parser);
+	parserFree(treeParser);
+	parser = 0;
+	treeParser = 0;
+	if (errcount) {
+		error("MA봰͵Ľһ%d\n", errcount);
+	}
+	info("ԪMA\n\n");
+}
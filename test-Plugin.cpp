@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* ʽC++, C++ɲ, ֽĽȽ.
+ * ûC++ʱ; ͬĹʽܼ */
+static const char *FOUMULA = ""
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"J:3*K-2*D;\n"
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MACD:(DIF-DEA)*2;\n"
+	"CHG:ABS(CLOSE-REF(CLOSE,6))/MAX(REF(HIGH-LOW,1),0.01)*100+1;\n"
+	"ZD:(HIGH-LOW)/(CLOSE-REF(CLOSE,1))+1;";
+
+/* FOUMULAֻһ */
+static const char *OTHER = ""
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"J:3*K-2*D;\n"
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MACD:(DIF-DEA)*2;\n"
+	"CHG:ABS(CLOSE-REF(CLOSE,6))/MAX(REF(HIGH-LOW,1),0.01)*100+2;\n"
+	"ZD:(HIGH-LOW)/(CLOSE-REF(CLOSE,1))+1;";
+
+static const char *NAMES[] = {
+	"RSI1", "K", "D", "J", "DIF", "DEA", "MACD", "CHG", "ZD",
+};
+
+using namespace tg;
+namespace tg { struct Quote ; }
+
+extern tg::Quote *q;
+
+static void *vmParser = 0;
+static void *pluginParser = 0;
+static bool loaded = false;
+static int errcount = 0;
+static char srcfile[1024];
+static char sofile[1024];
+
+/* ɲ, ûC++ʱ-1 */
+static int buildPlugin(void *p)
+{
+	const char *dir = getenv("TMPDIR");
+	if (!dir || !*dir)
+		dir = "/tmp";
+	snprintf(srcfile, sizeof(srcfile), "%s/tg-plugin-test.cpp", dir);
+	snprintf(sofile, sizeof(sofile), "%s/tg-plugin-test.so", dir);
+	if (parserGenerateCpp(p, "TEST", srcfile)) {
+		warn("C++ʧ\n");
+		++errcount;
+		return -1;
+	}
+	const char *cxx = getenv("CXX");
+	if (!cxx || !*cxx)
+		cxx = "c++";
+	char cmd[4096];
+	snprintf(cmd, sizeof(cmd), "%s -O2 -fPIC -shared -I. -o %s %s", cxx, sofile, srcfile);
+	if (system(cmd) != 0) {
+		warn("ʧ, : %s\n", cmd);
+		return -1;
+	}
+	return 0;
+}
+
+void testPluginInit()
+{
+	info("ʼԪPlugin\n");
+
+	vmParser = parserNew(0, testHandleError);
+	parserParse(vmParser, FOUMULA, strlen(FOUMULA));
+
+	pluginParser = parserNew(0, testHandleError);
+	parserParse(pluginParser, FOUMULA, strlen(FOUMULA));
+#ifndef _WIN32
+	if (buildPlugin(pluginParser))
+		return;
+	if (parserLoadPlugin(pluginParser, sofile)) {
+		warn("زʧ\n");
+		++errcount;
+		return;
+	}
+	loaded = true;
+
+	void *other = parserNew(0, testHandleError);
+	parserParse(other, OTHER, strlen(OTHER));
+	if (!parserLoadPlugin(other, sofile)) {
+		warn("ͬĹʽ˲\n");
+		++errcount;
+	}
+	parserFree(other);
+#endif
+}
+
+void testPlugin()
+{
+	if (!loaded)
+		return;
+	if (parserInterp(vmParser, q) || parserInterp(pluginParser, q)) {
+		warn("ʧ\n");
+		++errcount;
+		return;
+	}
+	for (unsigned i = 0; i < sizeof(NAMES)/sizeof(NAMES[0]); ++i) {
+		double f1, f2;
+		parserGetIndicator(vmParser, NAMES[i], &f1);
+		parserGetIndicator(pluginParser, NAMES[i], &f2);
+		if (!sameValue(f1, f2)) {
+			warn("һ %s %f %f\n", NAMES[i], f1, f2);
+			++errcount;
+		}
+	}
+}
+
+void testPluginShutdown()
+{
+	parserFree(vmParser);
+	parserFree(pluginParser);
+	vmParser = 0;
+	pluginParser = 0;
+	if (srcfile[0])
+		remove(srcfile);
+	if (sofile[0])
+		remove(sofile);
+	if (errcount) {
+		error("ֽһ%d\n", errcount);
+	}
+	info("ԪPlugin\n\n");
+}
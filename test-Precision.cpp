@@ -0,0 +1,283 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* float洢ʱ, ÿӦdoubleĽ뵽float, 
+ * FLT_EPSILON/2. ֻòʱ, floatָdoubleȫһ.
+ * ֻתȡdoubleֻ󼸸, ڴҪȫdouble洢 */
+static const char *FOUMULA = ""
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"J:3*K-2*D;\n"
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MACD:(DIF-DEA)*2;\n"
+	"MA20:MA(CLOSE,20);\n"
+	"PA:EMA(CLOSE*3+1,5);\n"
+	"PB:EMA(HIGH*2+LOW,7);\n"
+	"N:100;";
+
+static const char *NAMES[] = {
+	"RSI1", "K", "D", "J", "DIF", "DEA", "MACD", "MA20", "PA", "PB", "N",
+};
+
+/* float洢, DEADIF. PA,PBǹûм,
+ * PAֻdouble, parserInvalidateFromͷʱҪȡȫ */
+static const char *PARTIAL[] = { "DIF", "J", "PA" };
+
+/* ֻһAʱdoubleĽֻ󼸸, ڴԼʡһ */
+static const char *MEMORY_FORMULAS[] = {
+	"A:EMA(CLOSE,12);",
+	"A:MA(CLOSE,20);",
+	"A:HHV(HIGH,20);",
+	"A:CLOSE*2+1;",
+	"LC:=REF(CLOSE,1);\nA:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;",
+	"LC:=REF(CLOSE,1);\nA:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\nB:HIGH+LOW;",
+	"A:EMA(CLOSE,12)-EMA(CLOSE,26);",
+	"A:(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;",
+};
+#define NMEMORY (sizeof(MEMORY_FORMULAS)/sizeof(MEMORY_FORMULAS[0]))
+
+/* ӵһK߿ʼô, ʼʱK߲, תԴûн */
+#define FIRST_BARS 40
+
+/* ÿôKparserInvalidateFromǰ¼һ */
+#define INVALIDATE_INTERVAL 16
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+enum { PP_VM, PP_JIT, PP_PARTIAL, PP_ALL };
+static const char *MODE_NAMES[PP_ALL] = { "VM", "JIT", "" };
+
+static void *ref = 0; /* double */
+static void *parsers[PP_ALL];
+static void *memRefs[NMEMORY]; /* double */
+static void *memParsers[NMEMORY][PP_PARTIAL]; /* ȫfloat洢, VMJIT */
+static int calls = 0;
+static double maxErr = 0; /*  */
+static int errcount = 0;
+
+static bool isPartial(const char *name)
+{
+	for (unsigned i = 0; i < sizeof(PARTIAL)/sizeof(PARTIAL[0]); ++i) {
+		if (strcmp(PARTIAL[i], name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void *newParser(const char *formula, int mode)
+{
+	void *p = testNewParser(formula, mode == PP_JIT ? TM_JIT : TM_VM);
+	if (!p)
+		return 0;
+	int ret = mode == PP_PARTIAL
+		? parserSetPrecision(p, PARTIAL, sizeof(PARTIAL)/sizeof(PARTIAL[0]), PREC_FLOAT)
+		: parserSetPrecision(p, 0, 0, PREC_FLOAT);
+	if (ret) {
+		warn("parserSetPrecisionʧ %s\n", MODE_NAMES[mode]);
+		++errcount;
+	}
+	return p;
+}
+
+/* fӦd뵽float, NȻdouble */
+static void check(int mode, const char *name, double f, double d)
+{
+	bool isFloat = strcmp(name, "N") != 0 && (mode != PP_PARTIAL || isPartial(name));
+	double expect = isFloat ? (double)(float)d : d;
+	if (!sameValue(f, expect)) {
+		warn("float洢Ľһ %s %s %.12f %.12f\n", MODE_NAMES[mode], name, f, d);
+		++errcount;
+		return;
+	}
+	if (isFloat && fabs(d) >= FLT_MIN && fabs(d) <= FLT_MAX) {
+		double err = fabs(f - d) / fabs(d);
+		if (err > maxErr)
+			maxErr = err;
+	}
+}
+
+/* ֻAfloat洢, ӿյ鿪ʼparserAppendBar */
+static void checkFirstBars(unsigned k)
+{
+	Quote sq;
+	Value **vs[] = { &sq.open, &sq.high, &sq.low, &sq.close };
+	for (unsigned i = 0; i < sizeof(vs)/sizeof(vs[0]); ++i) {
+		*vs[i] = valueNew(VT_ARRAY_DOUBLE);
+		valueExtend(*vs[i], FIRST_BARS);
+	}
+	void *d = parserNew(0, testHandleError);
+	parserParse(d, MEMORY_FORMULAS[k], strlen(MEMORY_FORMULAS[k]));
+	void *ps[PP_PARTIAL];
+	for (int m = 0; m < PP_PARTIAL; ++m)
+		ps[m] = newParser(MEMORY_FORMULAS[k], m);
+	for (int i = 0; i < FIRST_BARS && i < q->close->size; ++i) {
+		quoteAppendBar(&sq, q->open->fs[i], q->high->fs[i], q->low->fs[i], q->close->fs[i]);
+		parserAppendBar(d, &sq);
+		for (int m = 0; m < PP_PARTIAL; ++m) {
+			if (!ps[m])
+				continue;
+			if (parserAppendBar(ps[m], &sq)) {
+				warn("float洢ʧ %s %s %d\n", MODE_NAMES[m], MEMORY_FORMULAS[k], i);
+				++errcount;
+				continue;
+			}
+			/* K߲ʱûн */
+			double f1, d1;
+			int fret = parserGetIndicator(ps[m], "A", &f1);
+			int dret = parserGetIndicator(d, "A", &d1);
+			if (fret != dret) {
+				warn("float洢еĽһ %s %s %d\n", MODE_NAMES[m], MEMORY_FORMULAS[k], i);
+				++errcount;
+			} else if (!dret) {
+				check(m, "A", f1, d1);
+			}
+		}
+	}
+	for (int m = 0; m < PP_PARTIAL; ++m)
+		parserFree(ps[m]);
+	parserFree(d);
+	for (unsigned i = 0; i < sizeof(vs)/sizeof(vs[0]); ++i)
+		valueFree(*vs[i]);
+}
+
+void testPrecisionInit()
+{
+	info("ʼԪPrecision\n");
+	info("ʽΪ\n%s\n", FOUMULA);
+
+	ref = parserNew(0, testHandleError);
+	parserParse(ref, FOUMULA, strlen(FOUMULA));
+	for (int m = 0; m < PP_ALL; ++m) {
+		parsers[m] = newParser(FOUMULA, m);
+	}
+	for (unsigned k = 0; k < NMEMORY; ++k) {
+		memRefs[k] = parserNew(0, testHandleError);
+		parserParse(memRefs[k], MEMORY_FORMULAS[k], strlen(MEMORY_FORMULAS[k]));
+		for (int m = 0; m < PP_PARTIAL; ++m)
+			memParsers[k][m] = newParser(MEMORY_FORMULAS[k], m);
+		checkFirstBars(k);
+	}
+	/* namesΪ0ʱcountȫ, refȻȫdouble洢 */
+	if (parserSetPrecision(ref, 0, 2, PREC_DOUBLE)) {
+		warn("parserSetPrecisionȫָʧ\n");
+		++errcount;
+	}
+	const char *unknown = "XYZ";
+	if (!parserSetPrecision(ref, &unknown, 1, PREC_FLOAT)) {
+		warn("parserSetPrecision˲ڵָ\n");
+		++errcount;
+	}
+}
+
+/* ֻAfloat洢ʱڴ, doubleһ */
+static void checkMemory(unsigned k)
+{
+	if (parserInterp(memRefs[k], q))
+		return;
+	int64_t d = parserSeriesBytes(memRefs[k]);
+	for (int m = 0; m < PP_PARTIAL; ++m) {
+		void *p = memParsers[k][m];
+		if (!p)
+			continue;
+		if (parserInterp(p, q)) {
+			warn("float洢ʧ %s %s\n", MODE_NAMES[m], MEMORY_FORMULAS[k]);
+			++errcount;
+			continue;
+		}
+		double f1, d1;
+		parserGetIndicator(p, "A", &f1);
+		parserGetIndicator(memRefs[k], "A", &d1);
+		check(m, "A", f1, d1);
+		/* ʡһfloat, , floatdoubleȡĸͬ */
+		int64_t f = parserSeriesBytes(p);
+		if (d - f < (int64_t)sizeof(float) * (q->close->size - 64) * 3 / 4) {
+			warn("float洢ûнʡڴ %s %s %lld %lld\n", MODE_NAMES[m], MEMORY_FORMULAS[k],
+				(long long)f, (long long)d);
+			++errcount;
+		}
+	}
+}
+
+/* backK֮ǰ¼, Ӧò */
+static void invalidate(void *p, int back)
+{
+	if (p && parserInvalidateFrom(p, q->close->no - back)) {
+		warn("parserInvalidateFromʧ\n");
+		++errcount;
+	}
+}
+
+void testPrecision()
+{
+	if (++calls % INVALIDATE_INTERVAL == 0) {
+		int back = calls / INVALIDATE_INTERVAL % 20;
+		invalidate(ref, back);
+		for (int m = 0; m < PP_ALL; ++m)
+			invalidate(parsers[m], back);
+		for (unsigned k = 0; k < NMEMORY; ++k) {
+			invalidate(memRefs[k], back);
+			for (int m = 0; m < PP_PARTIAL; ++m)
+				invalidate(memParsers[k][m], back);
+		}
+	}
+	for (unsigned k = 0; k < NMEMORY; ++k)
+		checkMemory(k);
+
+	if (parserInterp(ref, q))
+		return;
+	for (int m = 0; m < PP_ALL; ++m) {
+		if (!parsers[m])
+			continue;
+		if (parserInterp(parsers[m], q)) {
+			warn("float洢ʧ %s\n", MODE_NAMES[m]);
+			++errcount;
+			continue;
+		}
+		for (unsigned i = 0; i < sizeof(NAMES)/sizeof(NAMES[0]); ++i) {
+			double f, d;
+			parserGetIndicator(parsers[m], NAMES[i], &f);
+			parserGetIndicator(ref, NAMES[i], &d);
+			check(m, NAMES[i], f, d);
+		}
+	}
+}
+
+void testPrecisionShutdown()
+{
+	for (int m = 0; m < PP_ALL; ++m) {
+		parserFree(parsers[m]);
+		parsers[m] = 0;
+	}
+	parserFree(ref);
+	ref = 0;
+	for (unsigned k = 0; k < NMEMORY; ++k) {
+		for (int m = 0; m < PP_PARTIAL; ++m) {
+			parserFree(memParsers[k][m]);
+			memParsers[k][m] = 0;
+		}
+		parserFree(memRefs[k]);
+		memRefs[k] = 0;
+	}
+	info("float洢%g, %g\n", maxErr, FLT_EPSILON / 2);
+	if (maxErr > FLT_EPSILON / 2) {
+		warn("float洢\n");
+		++errcount;
+	}
+	if (errcount) {
+		error("float洢Ľһ%d\n", errcount);
+	}
+	info("ԪPrecision\n\n");
+}
@@ -0,0 +1,260 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* parserAppendBarparserUpdateLastBar, ÿKи¼.
+ * ÿζͷĽȽ, һθºqϵĽȽ.
+ * ֻCLOSE仯ʱHHV(HIGH-LOW,30)Ӧ¼. ֮ǰK,
+ * parserInvalidateFrom¼. T,Uмû.
+ * V,S1REF, ıű, Ҫ˻ؼ¼.
+ * TICKSregisterFunctionעĺ, ǳ, ûб仯ʱҲҪ */
+static const char *FOUMULA = ""
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),6,1)/SMA(ABS(CLOSE-LC),6,1)*100;\n"
+	"RSV:=(CLOSE-LLV(LOW,9))/(HHV(HIGH,9)-LLV(LOW,9))*100;\n"
+	"K:SMA(RSV,3,1);\n"
+	"D:SMA(K,3,1);\n"
+	"J:3*K-2*D;\n"
+	"DIF:EMA(CLOSE,12)-EMA(CLOSE,26);\n"
+	"DEA:EMA(DIF,9);\n"
+	"MACD:(DIF-DEA)*2;\n"
+	"MA20:MA(CLOSE,20);\n"
+	"H30:HHV(HIGH-LOW,30);\n"
+	"E5:EMA(SMA(CLOSE,5,2),5);\n"
+	"T:CLOSE/(HIGH-OPEN)+EMA(HIGH-OPEN,5);\n"
+	"U:SMA(OPEN-LOW,3,1)+SMA(CLOSE-OPEN,7,2)*EMA(ABS(CLOSE-OPEN),9);\n"
+	"V:EMA(REF(CLOSE,1)-CLOSE,5);\n"
+	"S0:=ABS(REF(LOW,1))*SMA(CLOSE,20,11);\n"
+	"S1:MAX(MAX(EMA(S0,14)-EMA(S0,7),0),0);\n"
+	"TK:TICKS(1);";
+
+static const char *NAMES[] = {
+	"RSI1", "K", "D", "J", "DIF", "DEA", "MACD", "MA20", "H30", "E5", "T", "U", "V", "S1",
+};
+
+/* ÿôKͷĽȽһ */
+#define SCRATCH_INTERVAL 16
+
+using namespace tg;
+
+extern tg::Quote *q;
+
+static Quote *sq = 0; /* µ */
+static void *parsers[TM_ALL];
+static void *qParser = 0; /* qparserInterp */
+static int bars = 0;
+static int errcount = 0;
+
+/* ÿεü1, ֻɲ */
+static int ticks = 0;
+static Value *TICKS(void *parser, int argc, const Value **args, Value *R)
+{
+	(void)parser;
+	(void)argc;
+	(void)args;
+	if (!R && !(R = valueNew(VT_DOUBLE)))
+		return 0;
+	R->f = ++ticks;
+	return R;
+}
+
+/* ģ¼: ֻǰnK */
+static void quoteTruncate(Quote *d, int n)
+{
+	Value *vs[] = { d->open, d->high, d->low, d->close };
+	for (unsigned i = 0; i < sizeof(vs)/sizeof(vs[0]); ++i) {
+		vs[i]->size = n;
+		vs[i]->no = n;
+	}
+}
+
+/* refϵĽȽ */
+static void compare(void *p, void *ref, const char *what, int mode)
+{
+	for (unsigned i = 0; i < sizeof(NAMES)/sizeof(NAMES[0]); ++i) {
+		double f1, f2;
+		parserGetIndicator(p, NAMES[i], &f1);
+		parserGetIndicator(ref, NAMES[i], &f2);
+		if (!sameValue(f1, f2)) {
+			warn("%sһ %s %s %d %.12f %.12f\n", what, TEST_MODE_NAMES[mode], NAMES[i], bars, f1, f2);
+			++errcount;
+		}
+	}
+}
+
+/* sqϴͷĽȽ */
+static void checkScratch()
+{
+	void *ref = testNewParser(FOUMULA, TM_VM);
+	Quote *d = quoteCopy(sq, 0);
+	parserInterp(ref, d);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (parsers[m])
+			compare(parsers[m], ref, "ͷ", m);
+	}
+	parserFree(ref);
+	quoteFree(d);
+}
+
+/* ָİ汾, ûб仯Ľڵû */
+static void getVersions(const char *name, unsigned int *versions)
+{
+	for (int m = 0; m < TM_ALL; ++m)
+		versions[m] = parsers[m] ? parserIndicatorVersion(parsers[m], name) : 0;
+}
+
+static void checkVersions(const char *name, const unsigned int *before, bool changed, const char *what)
+{
+	unsigned int after[TM_ALL];
+	getVersions(name, after);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (parsers[m] && (after[m] != before[m]) != changed) {
+			warn("%sʱ%s%s¼ %s %d\n", what, name, changed ? "û" : "", TEST_MODE_NAMES[m], bars);
+			++errcount;
+		}
+	}
+}
+
+/* ӵа64ֽڶ, , һûõԪΪNAN */
+static void checkStorage(const Value *v)
+{
+	bool padded = true;
+	for (int i = v->size; i < (v->size + 7) / 8 * 8; ++i) {
+		if (!isnan(v->fs[i]))
+			padded = false;
+	}
+	if ((uintptr_t)v->fs % 64 != 0 || v->capacity % 8 != 0 || !padded) {
+		warn("еڴûж %p %d %d\n", v->fs, v->size, v->capacity);
+		++errcount;
+	}
+}
+
+/* зʽ, appendΪfalseʱǸһK */
+static void runBar(bool append)
+{
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (!parsers[m])
+			continue;
+		int ret = append ? parserAppendBar(parsers[m], sq) : parserUpdateLastBar(parsers[m], sq);
+		if (ret) {
+			warn("ʧ %s\n", TEST_MODE_NAMES[m]);
+			++errcount;
+		}
+	}
+	if (bars % SCRATCH_INTERVAL == 0)
+		checkScratch();
+}
+
+/* backK֮ǰCLOSE, ¼ͷĽȽ, ٸĻ */
+static void correctBar(int back)
+{
+	int i = sq->close->size - 1 - back;
+	if (i < 1)
+		return;
+	int64_t no = sq->close->no - back;
+	double c = sq->close->fs[i];
+	for (int k = 0; k < 2; ++k) {
+		valueSet(sq->close, i, k ? c : c * 1.01);
+		for (int m = 0; m < TM_ALL; ++m) {
+			if (parsers[m] && parserInvalidateFrom(parsers[m], no)) {
+				warn("parserInvalidateFromʧ %s\n", TEST_MODE_NAMES[m]);
+				++errcount;
+			}
+		}
+		runBar(false);
+		checkScratch();
+	}
+}
+
+void testStreamInit()
+{
+	info("ʼԪStream\n");
+	info("ʽΪ\n%s\n", FOUMULA);
+
+	registerFunction("TICKS", TICKS);
+	sq = quoteCopy(q, 0);
+	for (int m = 0; m < TM_ALL; ++m) {
+		parsers[m] = testNewParser(FOUMULA, m);
+		if (parsers[m])
+			parserInterp(parsers[m], sq);
+	}
+	qParser = testNewParser(FOUMULA, TM_VM);
+	/* CLOSEڴ, ûб仯ʱͼ(LC)ҲҪ¼ */
+	valueExtend(sq->close, sq->close->capacity * 2 + 1);
+	runBar(false);
+}
+
+void testStream()
+{
+	int i = q->close->size - 1;
+	double o = q->open->fs[i], h = q->high->fs[i], l = q->low->fs[i], c = q->close->fs[i];
+	double mid = (o + c) / 2;
+	++bars;
+
+	/* , ,  */
+	quoteAppendBar(sq, o, o, o, o);
+	checkStorage(sq->close);
+	runBar(true);
+	quoteUpdateLastBar(sq, o, mid > o ? mid : o, mid < o ? mid : o, mid);
+	runBar(false);
+	quoteUpdateLastBar(sq, o, h, l, (h + l) / 2);
+	runBar(false);
+
+	/* ֻCLOSE仯, H30¼ */
+	unsigned int h30[TM_ALL], ma20[TM_ALL];
+	getVersions("H30", h30);
+	getVersions("MA20", ma20);
+	quoteUpdateLastBar(sq, o, h, l, c);
+	runBar(false);
+	checkVersions("H30", h30, false, "ֻCLOSE仯");
+	if (c != (h + l) / 2)
+		checkVersions("MA20", ma20, true, "CLOSE仯");
+
+	/* ûб仯, ʲôҲ, ֻעĺȻ */
+	unsigned int tk[TM_ALL];
+	getVersions("MA20", ma20);
+	getVersions("TK", tk);
+	runBar(false);
+	checkVersions("MA20", ma20, false, "ûб仯");
+	checkVersions("TK", tk, true, "ûб仯");
+
+	if (bars % SCRATCH_INTERVAL == 0)
+		correctBar(bars / SCRATCH_INTERVAL % 40);
+
+	parserInterp(qParser, q);
+	for (int m = 0; m < TM_ALL; ++m) {
+		if (parsers[m])
+			compare(parsers[m], qParser, "qϵĽ", m);
+	}
+}
+
+void testStreamShutdown()
+{
+	/* ¼غνӲ, Ӧôͷ */
+	if (sq->close->size > 200) {
+		quoteTruncate(sq, 200);
+		bars = 0;
+		runBar(true);
+		quoteUpdateLastBar(sq, 1, 2, 0.5, 1.5);
+		runBar(false);
+	}
+
+	for (int m = 0; m < TM_ALL; ++m) {
+		parserFree(parsers[m]);
+		parsers[m] = 0;
+	}
+	parserFree(qParser);
+	qParser = 0;
+	quoteFree(sq);
+	sq = 0;
+	if (errcount) {
+		error("еĽһ%d\n", errcount);
+	}
+	info("ԪStream\n\n");
+}
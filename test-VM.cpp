@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "lexer.h"
+#include "parser.h"
+
+#include "test-base.h"
+
+/* RSI,KDJ,MACDһ,ֱASTֽ,ȽϽ.
+ * CHGԴREFԪں, MIDC1Դ,
+ * NZ-00, +0, ܻ. ZDԳΪ0 */
+static const char *FOUMULA = ""
+	"N1:=6;\n"
+	"N2:=12;\n"
+	"N3:=24;\n"
+	"LC:=REF(CLOSE,1);\n"
+	"RSI1:SMA(MAX(CLOSE-LC,0),N1,1)/SMA(ABS(CLOSE-LC),N1,1)*100;\n"
+	"RSI2:SMA(MAX(CLOSE-LC,0),N2,1)/SMA(ABS(CLOSE-LC),N2,1)*100;\n"
+	"RSI3:SMA(MAX(CLOSE-LC,0),N3,1)/SMA(ABS(CLOSE-LC),N3,1)*100;\n"
+	"N:=3;\n"
+	"M1:=9;\n"
+	"M2:=3;\n"
+	"RSV:=(CLOSE-LLV(LOW,N))/(HHV(HIGH,N)-LLV(LOW,N))*100;\n"
+	"K:SMA(RSV,M1,1);\n"
+	"D:SMA(K,M2,1);\n"
+	"J:3*K-2*D;\n"
+	"SHORT:=12;\n"
+	"LONG:=26;\n"
+	"MID:=9;\n"
+	"DIF:EMA(CLOSE,SHORT)-EMA(CLOSE,LONG);\n"
+	"DEA:EMA(DIF,MID);\n"
+	"MACD:(DIF-DEA)*2;\n"
+	"CHG:ABS(CLOSE-REF(CLOSE,N1))/MAX(REF(HIGH-LOW,1),0.01)*100+1;\n"
+	"MID:2*(HIGH+LOW)/4*3/1-0;\n"
+	"C1:CLOSE*1;\n"
+	"NZ:(CLOSE-CLOSE)/(LOW-HIGH-1)+0;\n"
+	"ZD:(HIGH-LOW)/(CLOSE-REF(CLOSE,1))+1;";
+
+static const char *NAMES[] = {
+	"RSI1", "RSI2", "RSI3", "RSV", "K", "D", "J", "DIF", "DEA", "MACD", "CHG", "MID", "C1", "NZ", "ZD",
+};
+
+using namespace tg;
+namespace tg { struct Quote ; }
+
+extern tg::Quote *q;
+
+/* COUNTERregisterFunctionעĺ, òܺϳһ, BǱA1 */
+static const char *IMPURE = "A:COUNTER(1);B:COUNTER(1);";
+
+/* ֻҪмָ */
+static const char *OUTPUTS[] = { "J", "RSI1", };
+
+static void *treeParser = 0;
+static void *vmParser = 0;
+static void *demandParser = 0;
+static void *jitParser = 0;
+static void *impureParsers[2]; /* ASTֽ */
+static int errcount = 0;
+
+/* ÿεü1, ֻɲ */
+static int counter = 0;
+static Value *COUNTER(void *parser, int argc, const Value **args, Value *R)
+{
+	(void)parser;
+	(void)argc;
+	(void)args;
+	if (!R && !(R = valueNew(VT_DOUBLE)))
+		return 0;
+	R->f = ++counter;
+	return R;
+}
+
+void testVMInit()
+{
+	info("ʼԪVM\n");
+
+	treeParser = parserNew(0, testHandleError);
+	parserParse(treeParser, FOUMULA, strlen(FOUMULA));
+	parserSetInterpMode(treeParser, IM_TREE);
+
+	vmParser = parserNew(0, testHandleError);
+	parserParse(vmParser, FOUMULA, strlen(FOUMULA));
+	if (parserSetInterpMode(vmParser, IM_VM)) {
+		warn("VMʧ\n");
+		++errcount;
+	}
+
+	jitParser = parserNew(0, testHandleError);
+	parserParse(jitParser, FOUMULA, strlen(FOUMULA));
+	if (parserSetInterpMode(jitParser, IM_JIT)) {
+		warn("JITʧ\n");
+		++errcount;
+	}
+
+	demandParser = parserNew(0, testHandleError);
+	parserParse(demandParser, FOUMULA, strlen(FOUMULA));
+	/* namesΪ0ʱcountȫ */
+	if (parserSetOutputs(demandParser, 0, 3)) {
+		warn("VMȫָʧ\n");
+		++errcount;
+	}
+	if (parserSetOutputs(demandParser, OUTPUTS, sizeof(OUTPUTS)/sizeof(OUTPUTS[0]))) {
+		warn("VMָʧ\n");
+		++errcount;
+	}
+
+	registerFunction("COUNTER", COUNTER);
+	for (int i = 0; i < 2; ++i) {
+		impureParsers[i] = parserNew(0, testHandleError);
+		parserParse(impureParsers[i], IMPURE, strlen(IMPURE));
+		parserSetInterpMode(impureParsers[i], i ? IM_VM : IM_TREE);
+	}
+}
+
+void testVM()
+{
+	if (parserInterp(treeParser, q) || parserInterp(vmParser, q) || parserInterp(demandParser, q)
+			|| parserInterp(jitParser, q)) {
+		warn("VMʧ\n");
+		++errcount;
+		return;
+	}
+	for (unsigned i = 0; i < sizeof(NAMES)/sizeof(NAMES[0]); ++i) {
+		double f1, f2;
+		parserGetIndicator(treeParser, NAMES[i], &f1);
+		parserGetIndicator(vmParser, NAMES[i], &f2);
+		if (!sameValue(f1, f2)) {
+			warn("VMһ %s %f %f\n", NAMES[i], f1, f2);
+			++errcount;
+		}
+		parserGetIndicator(jitParser, NAMES[i], &f2);
+		if (!sameValue(f1, f2)) {
+			warn("JITһ %s %f %f\n", NAMES[i], f1, f2);
+			++errcount;
+		}
+	}
+	for (unsigned i = 0; i < sizeof(OUTPUTS)/sizeof(OUTPUTS[0]); ++i) {
+		double f1, f2;
+		parserGetIndicator(treeParser, OUTPUTS[i], &f1);
+		parserGetIndicator(demandParser, OUTPUTS[i], &f2);
+		if (!sameValue(f1, f2)) {
+			warn("VMĽһ %s %f %f\n", OUTPUTS[i], f1, f2);
+			++errcount;
+		}
+	}
+	if (!parserGetIndicator(demandParser, "MACD", 0)) {
+		warn("VM˲ҪָMACD\n");
+		++errcount;
+	}
+	for (int i = 0; i < 2; ++i) {
+		double a = 0, b = 0;
+		parserInterp(impureParsers[i], q);
+		parserGetIndicator(impureParsers[i], "A", &a);
+		parserGetIndicator(impureParsers[i], "B", &b);
+		if (b != a + 1) {
+			warn("%sCOUNTERĽ %f %f\n", i ? "VM" : "AST", a, b);
+			++errcount;
+		}
+	}
+}
+
+void testVMShutdown()
+{
+	parserFree(treeParser);
+	parserFree(vmParser);
+	parserFree(demandParser);
+	parserFree(jitParser);
+	for (int i = 0; i < 2; ++i) {
+		parserFree(impureParsers[i]);
+		impureParsers[i] = 0;
+	}
+	jitParser = 0;
+	treeParser = 0;
+	vmParser = 0;
+	demandParser = 0;
+	if (errcount) {
+		error("VMASTһ%d\n", errcount);
+	}
+	info("ԪVM\n\n");
+}
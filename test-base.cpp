@@ -1,6 +1,12 @@
 #include "test-base.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "base.h"
+#include "indicators.h"
+#include "parser.h"
 
 namespace tg {
 
@@ -14,4 +20,56 @@ int testHandleError(int lineno, int charpos, int error, const char *errmsg, void
 	return 1;
 }
 
+bool sameValue(double f1, double f2)
+{
+	return (f1 == f2 && signbit(f1) == signbit(f2)) || (isnan(f1) && isnan(f2));
+}
+
+Value *valueCopy(const Value *X)
+{
+	Value *v = valueNew(VT_ARRAY_DOUBLE);
+	valueExtend(v, X->size);
+	for (int i = 0; i < X->size; ++i)
+		valueAdd(v, X->fs[i]);
+	return v;
+}
+
+Quote *quoteCopy(const Quote *d, int keep)
+{
+	Quote *c = (Quote *)malloc(sizeof(*c));
+	c->open = valueCopy(d->open);
+	c->high = valueCopy(d->high);
+	c->low = valueCopy(d->low);
+	c->close = valueCopy(d->close);
+	if (keep)
+		quoteSetKeep(c, keep);
+	return c;
+}
+
+void quoteFree(Quote *d)
+{
+	if (!d)
+		return;
+	valueFree(d->open);
+	valueFree(d->high);
+	valueFree(d->low);
+	valueFree(d->close);
+	free(d);
+}
+
+const char *TEST_MODE_NAMES[TM_ALL] = { "VM", "TREE", "JIT" };
+
+void *testNewParser(const char *formula, int mode)
+{
+	void *p = parserNew(0, testHandleError);
+	parserParse(p, formula, strlen(formula));
+	if (mode == TM_TREE)
+		parserSetInterpMode(p, IM_TREE);
+	else if (mode == TM_JIT && parserSetInterpMode(p, IM_JIT)) {
+		parserFree(p);
+		return 0;
+	}
+	return p;
+}
+
 }
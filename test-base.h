@@ -3,8 +3,26 @@
 
 namespace tg {
 
+struct Value;
+struct Quote;
+
 int testHandleError(int lineno, int charpos, int error, const char *errmsg, void *userdata);
 
+/* Ƿһ: NANNANһ, +0-0һ */
+bool sameValue(double f1, double f2);
+
+/* XȫԪصµ */
+Value *valueCopy(const Value *X);
+/* d, keepΪ0ʱԺֻkeepK(quoteSetKeep) */
+Quote *quoteCopy(const Quote *d, int keep);
+void quoteFree(Quote *d);
+
+/* еĲбȽϵļֽзʽ */
+enum { TM_VM, TM_TREE, TM_JIT, TM_ALL };
+extern const char *TEST_MODE_NAMES[TM_ALL];
+/* formula, mode(TM_VM). ֧JITʱ0 */
+void *testNewParser(const char *formula, int mode);
+
 }
 
 #endif
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include <malloc.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "base.h"
 #include "indicators.h"
+#include "parser.h"
+#include "plugin.h"
+#include "test-base.h"
 
 using namespace tg;
 
@@ -99,39 +103,103 @@ static void testShutdown()
 	extern void test##name##Shutdown(); \
 	test##name##Shutdown();
 
+/* interp gen 公式文件 插件名 输出文件: 生成插件的C++代码, 不运行测试 */
+static int generatePlugin(const char *formula, const char *name, const char *output)
+{
+	tg::indicatorInit();
+	void *parser = parserNew(0, testHandleError);
+	int ret = parserParseFile(parser, formula);
+	if (!ret)
+		ret = parserGenerateCpp(parser, name, output);
+	parserFree(parser);
+	tg::indicatorShutdown();
+	return ret ? 1 : 0;
+}
+
+/* interp builtin: 重新生成所有内置公式的builtin-XXX.cpp */
+static int generateBuiltins()
+{
+	tg::indicatorInit();
+	int count, ret = 0;
+	const tg::BuiltinFormula *bfs = tg::builtinFormulas(&count);
+	for (int i = 0; i < count && !ret; ++i) {
+		char filename[256];
+		snprintf(filename, sizeof(filename), "builtin-%s.cpp", bfs[i].name);
+		void *parser = parserNew(0, testHandleError);
+		ret = parserParse(parser, bfs[i].formula, strlen(bfs[i].formula));
+		if (!ret)
+			ret = parserGenerateBuiltin(parser, bfs[i].name, filename);
+		parserFree(parser);
+	}
+	tg::indicatorShutdown();
+	return ret ? 1 : 0;
+}
+
 int main(int argc, const char **argv)
 {
+	if (argc == 5 && strcmp(argv[1], "gen") == 0)
+		return generatePlugin(argv[2], argv[3], argv[4]);
+	if (argc == 2 && strcmp(argv[1], "builtin") == 0)
+		return generateBuiltins();
+
 	testInit(100);
 	tg::indicatorInit();
 
 	TEST_INIT(RSI);
 	TEST_INIT(KDJ);
 	TEST_INIT(MACD);
+	TEST_INIT(MA);
+	TEST_INIT(HHV);
+	TEST_INIT(VM);
+	TEST_INIT(FormulaSet);
+	TEST_INIT(Plugin);
+	TEST_INIT(Builtin);
+	TEST_INIT(Stream);
+	TEST_INIT(Lookback);
+	TEST_INIT(Precision);
+	TEST_INIT(Bench);
 
 	const int INTERVAL = 1;
 
-	for (int i = startIndex, count = startIndex; i < closes.size; i += INTERVAL, ++count) {
+	for (int i = startIndex; i < closes.size; i += INTERVAL) {
 		for (int j = i; j < (i + INTERVAL) && j < closes.size; ++j) {
-			if (j == i) { /* 第一个元素模拟股票软件中新增了一根K线 */
-				valueAdd(q->open, *(double *)arrayGet(&opens, j));
-				valueAdd(q->high, *(double *)arrayGet(&highs, j));
-				valueAdd(q->low, *(double *)arrayGet(&lows, j));
-				valueAdd(q->close, *(double *)arrayGet(&closes, j));
-			} else { /* 其他元素模拟股票软件中当前K线的更新 */
-				valueSet(q->open, count, *(double *)arrayGet(&opens, j));
-				valueSet(q->high, count, *(double *)arrayGet(&highs, j));
-				valueSet(q->low, count, *(double *)arrayGet(&lows, j));
-				valueSet(q->close, count, *(double *)arrayGet(&closes, j));
-			}
+			double o = *(double *)arrayGet(&opens, j);
+			double h = *(double *)arrayGet(&highs, j);
+			double l = *(double *)arrayGet(&lows, j);
+			double c = *(double *)arrayGet(&closes, j);
+			if (j == i) /* 第一个元素模拟股票软件中新增了一根K线 */
+				quoteAppendBar(q, o, h, l, c);
+			else /* 其他元素模拟股票软件中当前K线的更新 */
+				quoteUpdateLastBar(q, o, h, l, c);
 			TEST(RSI);
 			TEST(KDJ);
 			TEST(MACD);
+			TEST(MA);
+			TEST(HHV);
+			TEST(VM);
+			TEST(FormulaSet);
+			TEST(Plugin);
+			TEST(Builtin);
+			TEST(Stream);
+			TEST(Lookback);
+			TEST(Precision);
+			TEST(Bench);
 		}
 	}
 
 	TEST_SHUTDOWN(RSI);
 	TEST_SHUTDOWN(KDJ);
 	TEST_SHUTDOWN(MACD);
+	TEST_SHUTDOWN(MA);
+	TEST_SHUTDOWN(HHV);
+	TEST_SHUTDOWN(VM);
+	TEST_SHUTDOWN(FormulaSet);
+	TEST_SHUTDOWN(Plugin);
+	TEST_SHUTDOWN(Builtin);
+	TEST_SHUTDOWN(Stream);
+	TEST_SHUTDOWN(Lookback);
+	TEST_SHUTDOWN(Precision);
+	TEST_SHUTDOWN(Bench);
 
 	tg::indicatorShutdown();
 	testShutdown();
@@ -0,0 +1,909 @@
+#include "vm.h"
+
+#include <assert.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base.h"
+#include "indicators.h"
+#include "parser-impl.h"
+
+namespace tg {
+
+/* ------ 뿪ʼ ------ */
+
+/* ӱʽĹؼ, ṹͬıʽؼͬ.
+ * ȽϺͼϣʱֽڽ, ʹǰҪ */
+struct ExprKey {
+	int op; /* OpCode, ΪOP_ALL */
+	ValueFn fn;
+	int argc;
+	int args[MAX_ARGC]; /* ڵļĴ */
+	int type; /*  */
+	double f; /* ֵ */
+};
+
+static int exprKeyCmp(const void *key1, const void *key2)
+{
+	return memcmp(key1, key2, sizeof(ExprKey));
+}
+
+static unsigned int exprKeyHash(const void *key)
+{
+	const unsigned char *s = (const unsigned char *)key;
+	unsigned int hash = 0;
+	for (unsigned i = 0; i < sizeof(ExprKey); ++i) {
+		hash = hash * 131 + s[i];
+	}
+	return (hash & 0x7FFFFFFF);
+}
+
+struct Compiler {
+	Parser *p;
+	Program *prog;
+	Array regs; // Value *
+	Array flags; // unsigned char
+	int stmtBase; /* ǰʽĵһStmtstmtRegsеλ */
+	int nstmts; /* ǰʽѾõStmt */
+	HashTable exprs; /* <ExprKey *, Ĵ>, ͬӱʽֻһ */
+	Array keys; // ExprKey *
+};
+
+/* ҽṹͬıʽ, ҵļĴ, 򷵻-1 */
+static int findExpr(Compiler *c, const ExprKey *key)
+{
+	void *reg;
+	if (hashTableFind(&c->exprs, key, &reg))
+		return -1;
+	return (int)(intptr_t)reg;
+}
+
+static int addExpr(Compiler *c, const ExprKey *key, int reg)
+{
+	ExprKey *k = (ExprKey *)malloc(sizeof(*k));
+	if (!k)
+		return -1;
+	memcpy(k, key, sizeof(*k));
+	ExprKey **pk = (ExprKey **)arrayAdd(&c->keys);
+	if (!pk) {
+		free(k);
+		return -1;
+	}
+	*pk = k;
+	return hashTableInsert(&c->exprs, k, (void *)(intptr_t)reg, 0);
+}
+
+static int newReg(Compiler *c, Value *v, unsigned char flags)
+{
+	Value **pv = (Value **)arrayAdd(&c->regs);
+	unsigned char *pf = (unsigned char *)arrayAdd(&c->flags);
+	if (!pv || !pf)
+		return -1;
+	*pv = v;
+	*pf = flags;
+	return c->regs.size - 1;
+}
+
+static bool isConst(Compiler *c, int reg)
+{
+	return (*(unsigned char *)arrayGet(&c->flags, reg) & RF_CONST) != 0;
+}
+
+static bool isArray(Compiler *c, int reg)
+{
+	return (*(unsigned char *)arrayGet(&c->flags, reg) & RF_ARRAY) != 0;
+}
+
+static double constValue(Compiler *c, int reg)
+{
+	const Value *v = *(Value **)arrayGet(&c->regs, reg);
+	assert(isConst(c, reg));
+	return v->type == VT_INT ? v->i : v->f;
+}
+
+/* I_REFȽӿںһ, Сضϳ */
+static int constInt(Compiler *c, int reg)
+{
+	const Value *v = *(Value **)arrayGet(&c->regs, reg);
+	assert(isConst(c, reg));
+	return v->type == VT_INT ? (int)v->i : (int)v->f;
+}
+
+/* ػĺ: һ,ǳʱֱӵں */
+static const struct {
+	ValueFn fn;
+	enum OpCode op;
+	int argc;
+} KERNELS[] = {
+	{ I_REF, OP_REF, 2 },
+	{ I_MAX, OP_MAX, 2 },
+	{ I_ABS, OP_ABS, 1 },
+	{ I_HHV, OP_HHV, 2 },
+	{ I_LLV, OP_LLV, 2 },
+	{ I_MA, OP_MA, 2 },
+	{ I_EMA, OP_EMA, 2 },
+	{ I_SMA, OP_SMA, 3 },
+};
+
+static char arithOp(enum OpCode op)
+{
+	switch (op) {
+	case OP_ADD: return '+';
+	case OP_SUB: return '-';
+	case OP_MUL: return '*';
+	case OP_DIV: return '/';
+	default: break;
+	}
+	assert(0);
+	return 0;
+}
+
+/* ݲڱʱ֪Ϣѡָ, ػʱʹͨõָ */
+static void lowerInstr(Compiler *c, Instr *ins, enum OpCode op, ValueFn fn, int argc, const int *args)
+{
+	ins->op = op;
+	ins->fn = fn;
+	ins->a = argc > 0 ? args[0] : 0;
+	ins->b = argc > 1 ? args[1] : 0;
+	ins->n = 0;
+	ins->m = 0;
+	ins->f = 0;
+	switch (op) {
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+		ins->n = arithOp(op);
+		if (isArray(c, args[0]) && isArray(c, args[1])) {
+			ins->op = OP_ARITH_AA;
+		} else if (isArray(c, args[0]) && isConst(c, args[1])) {
+			ins->op = OP_ARITH_AN;
+			ins->b = 0;
+			ins->f = constValue(c, args[1]);
+		} else if (isConst(c, args[0]) && isArray(c, args[1])) {
+			ins->op = OP_ARITH_NA;
+			ins->a = args[1];
+			ins->b = 0;
+			ins->f = constValue(c, args[0]);
+		}
+		break;
+	case OP_CALL:
+		for (unsigned k = 0; k < sizeof(KERNELS)/sizeof(KERNELS[0]); ++k) {
+			if (KERNELS[k].fn != fn)
+				continue;
+			if (KERNELS[k].argc != argc || !isArray(c, args[0]))
+				break;
+			bool ok = true;
+			for (int i = 1; i < argc; ++i) {
+				if (!isConst(c, args[i]))
+					ok = false;
+			}
+			if (!ok)
+				break;
+			ins->op = KERNELS[k].op;
+			ins->fn = 0;
+			ins->b = 0;
+			if (ins->op == OP_MAX) {
+				ins->f = constValue(c, args[1]);
+			} else if (argc > 1) {
+				ins->n = constInt(c, args[1]);
+			}
+			if (argc > 2)
+				ins->m = constInt(c, args[2]);
+			break;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* һָ,ؽڵļĴ.
+ * ѾнṹָͬʱֱӸļĴ,ʽͳDAG.
+ * registerFunctionעĺÿεõĽܲͬ, ͬASTһÿ,  */
+static int emit(Compiler *c, enum OpCode op, ValueFn fn, int argc, const int *args)
+{
+	ExprKey key;
+	assert(argc >= 0 && argc <= MAX_ARGC);
+	memset(&key, 0, sizeof(key));
+	key.op = op;
+	key.fn = fn;
+	key.argc = argc;
+	if (argc > 0)
+		memcpy(key.args, args, sizeof(int) * argc);
+	bool shared = op != OP_CALL || isPureFunction(fn);
+	int dst = shared ? findExpr(c, &key) : -1;
+	if (dst >= 0)
+		return dst;
+
+	Instr *ins = (Instr *)arrayAdd(&c->prog->instrs);
+	if (!ins)
+		return -1;
+	lowerInstr(c, ins, op, fn, argc, args);
+	unsigned char flags = RF_OWN;
+	if (ins->op == OP_VAR) {
+		flags = RF_ARRAY; /* ñ */
+	} else if (ins->op != OP_CALL && ins->op >= OP_ARITH_AA) {
+		flags |= RF_ARRAY;
+	}
+	dst = newReg(c, 0, flags);
+	if (dst < 0)
+		return -1;
+	ins->dst = dst;
+	if (ins->op == OP_CALL) {
+		/* Ĵoperands */
+		ins->a = c->prog->operands.size;
+		ins->b = argc;
+		ins->n = isPureFunction(fn);
+		for (int i = 0; i < argc; ++i) {
+			int *pr = (int *)arrayAdd(&c->prog->operands);
+			if (!pr)
+				return -1;
+			*pr = args[i];
+		}
+		if (argc > c->prog->maxArgc)
+			c->prog->maxArgc = argc;
+	}
+	if (shared && addExpr(c, &key, dst))
+		return -1;
+	return dst;
+}
+
+static int compileExpr(Compiler *c, Node *node);
+
+/* vŵĴ, vProgramӹ */
+static int addConst(Compiler *c, Value *v)
+{
+	ExprKey key;
+	memset(&key, 0, sizeof(key));
+	key.op = OP_ALL;
+	key.type = v->type;
+	key.f = v->type == VT_INT ? v->i : v->f;
+	int r = findExpr(c, &key);
+	if (r >= 0) {
+		valueFree(v);
+		return r;
+	}
+	r = newReg(c, v, RF_OWN | RF_CONST);
+	if (r < 0) {
+		valueFree(v);
+		return -1;
+	}
+	if (addExpr(c, &key, r))
+		return -1;
+	return r;
+}
+
+static int compileNumber(Compiler *c, const Value *val)
+{
+	Value *v = valueNew(val->type);
+	if (!v)
+		return -1;
+	if (val->type == VT_INT) {
+		v->i = val->i;
+	} else {
+		v->f = val->f;
+	}
+	return addConst(c, v);
+}
+
+/* ۵: ڱʱ */
+static int foldConst(Compiler *c, enum OpCode op, int lhs, int rhs)
+{
+	const Value *x = *(Value **)arrayGet(&c->regs, lhs);
+	const Value *y = *(Value **)arrayGet(&c->regs, rhs);
+	Value *v = 0;
+	switch (op) {
+	case OP_ADD: v = ADD(x, y, 0); break;
+	case OP_SUB: v = SUB(x, y, 0); break;
+	case OP_MUL: v = MUL(x, y, 0); break;
+	case OP_DIV: v = DIV(x, y, 0); break;
+	default: break;
+	}
+	if (!v)
+		return -1;
+	return addConst(c, v);
+}
+
+static int emitArith(Compiler *c, enum OpCode op, int lhs, int rhs)
+{
+	if (isConst(c, lhs) && isConst(c, rhs))
+		return foldConst(c, op, lhs, rhs);
+	int args[2] = { lhs, rhs };
+	return emit(c, op, 0, 2, args);
+}
+
+static int compileIdExpr(Compiler *c, IdExpr *e)
+{
+	if (e->fn)
+		return emit(c, OP_VAR, e->fn, 0, 0);
+	/* ֻǰѾStmt */
+	if (e->slot < 0 || e->slot >= c->nstmts) {
+		debug("ʧ,%sڶ֮ǰʹ\n", e->val.data);
+		return -1;
+	}
+	return c->prog->stmtRegs[c->stmtBase + e->slot];
+}
+
+static int compileFuncCall(Compiler *c, FuncCall *e)
+{
+	assert(e->fn);
+	int argc = e->args ? e->args->exprs.size : 0;
+	int args[MAX_ARGC];
+	if (argc > MAX_ARGC)
+		return -1;
+	for (int i = 0; i < argc; ++i) {
+		Node **arr = (Node **)e->args->exprs.data;
+		args[i] = compileExpr(c, arr[i]);
+		if (args[i] < 0)
+			return -1;
+	}
+	/* ADD(X,Y)X+Yͬһָ */
+	if (argc == 2) {
+		if (e->fn == I_ADD) return emitArith(c, OP_ADD, args[0], args[1]);
+		if (e->fn == I_SUB) return emitArith(c, OP_SUB, args[0], args[1]);
+		if (e->fn == I_MUL) return emitArith(c, OP_MUL, args[0], args[1]);
+		if (e->fn == I_DIV) return emitArith(c, OP_DIV, args[0], args[1]);
+	}
+	return emit(c, OP_CALL, e->fn, argc, args);
+}
+
+static int compileBinaryExpr(Compiler *c, BinaryExpr *e)
+{
+	int lhs = compileExpr(c, e->lhs);
+	if (lhs < 0)
+		return -1;
+	int rhs = compileExpr(c, e->rhs);
+	if (rhs < 0)
+		return -1;
+	switch (e->op) {
+	case TK_ADD: return emitArith(c, OP_ADD, lhs, rhs); /* + */
+	case TK_SUB: return emitArith(c, OP_SUB, lhs, rhs); /* - */
+	case TK_MUL: return emitArith(c, OP_MUL, lhs, rhs); /* * */
+	case TK_DIV: return emitArith(c, OP_DIV, lhs, rhs); /* / */
+	default:
+		break;
+	}
+	return -1;
+}
+
+static int compileExpr(Compiler *c, Node *node)
+{
+	switch (node->type) {
+	case NT_INT_EXPR: return compileNumber(c, ((IntExpr *)node)->value);
+	case NT_DECIMAL_EXPR: return compileNumber(c, ((DecimalExpr *)node)->value);
+	case NT_ID_EXPR: return compileIdExpr(c, (IdExpr *)node);
+	case NT_FUNC_CALL: return compileFuncCall(c, (FuncCall *)node);
+	case NT_BINARY_EXPR: return compileBinaryExpr(c, (BinaryExpr *)node);
+	default:
+		break;
+	}
+	return -1;
+}
+
+/* float洢Stmtתһ, StmtĽΪתļĴ. ʽǵ
+ * طڱʱѾʹdoubleļĴ. ʱ֪Ľ(,עĺ)Ȼdouble */
+/* ıREF(ͼ)ռԼڴ, Ᵽһfloatڴ */
+static bool isView(Compiler *c, int reg)
+{
+	const Instr *instrs = (const Instr *)c->prog->instrs.data;
+	for (int i = 0; i < c->prog->instrs.size; ++i) {
+		if (instrs[i].dst == reg)
+			return instrs[i].op == OP_VAR || instrs[i].op == OP_REF;
+	}
+	return false;
+}
+
+static int addFloatOutputs(Compiler *c, Parser **ps, int n)
+{
+	int base = 0;
+	for (int k = 0; k < n; ++k) {
+		Stmt **arr = (Stmt **)ps[k]->ast->stmts.data;
+		for (int i = 0; i < ps[k]->ast->stmts.size; ++i) {
+			int *pr = &c->prog->stmtRegs[base + i];
+			if (!arr[i]->f32 || !arr[i]->live || !isArray(c, *pr) || isView(c, *pr))
+				continue;
+			/* ͬһļStmtһָ */
+			int r = emit(c, OP_FLOAT32, 0, 1, pr);
+			if (r < 0)
+				return -1;
+			*pr = r;
+		}
+		base += ps[k]->ast->stmts.size;
+	}
+	return 0;
+}
+
+/* liveStmtĽ, ܱŻ */
+static void markOutputs(Program *prog, Parser **ps, int n)
+{
+	int base = 0;
+	for (int k = 0; k < n; ++k) {
+		Stmt **arr = (Stmt **)ps[k]->ast->stmts.data;
+		for (int i = 0; i < ps[k]->ast->stmts.size; ++i) {
+			if (arr[i]->live)
+				prog->regFlags[prog->stmtRegs[base + i]] |= RF_OUTPUT;
+		}
+		base += ps[k]->ast->stmts.size;
+	}
+}
+
+int useDefInit(UseDef *ud, Program *prog)
+{
+	int nregs = prog->nregs > 0 ? prog->nregs : 1;
+	ud->def = (int *)malloc(sizeof(int) * nregs);
+	ud->uses = (int *)malloc(sizeof(int) * nregs);
+	ud->user = (int *)malloc(sizeof(int) * nregs);
+	if (!ud->def || !ud->uses || !ud->user) {
+		useDefFree(ud);
+		return -1;
+	}
+	for (int i = 0; i < prog->nregs; ++i) {
+		ud->def[i] = -1;
+		ud->uses[i] = 0;
+		ud->user[i] = -1;
+	}
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		const Instr *ins = (const Instr *)arrayGet(&prog->instrs, i);
+		ud->def[ins->dst] = i;
+		int regs[MAX_ARGC];
+		int n = instrOperands(prog, ins, regs);
+		for (int j = 0; j < n; ++j) {
+			ud->uses[regs[j]]++;
+			ud->user[regs[j]] = i;
+		}
+	}
+	return 0;
+}
+
+void useDefFree(UseDef *ud)
+{
+	free(ud->def);
+	free(ud->uses);
+	free(ud->user);
+	ud->def = ud->uses = ud->user = 0;
+}
+
+Instr *useDefInstr(UseDef *ud, Program *prog, int reg)
+{
+	if (ud->def[reg] < 0)
+		return 0;
+	return (Instr *)arrayGet(&prog->instrs, ud->def[reg]);
+}
+
+bool useDefIsTemp(const UseDef *ud, const Program *prog, int reg, int nuses)
+{
+	return ud->uses[reg] == nuses && !(prog->regFlags[reg] & RF_OUTPUT);
+}
+
+int programRemoveDead(Program *prog)
+{
+	unsigned char *live = (unsigned char *)malloc(prog->nregs > 0 ? prog->nregs : 1);
+	if (!live)
+		return -1;
+	for (int i = 0; i < prog->nregs; ++i) {
+		live[i] = (prog->regFlags[i] & RF_OUTPUT) != 0;
+	}
+
+	/* ָ˳, һξͿԱҪļĴ */
+	Instr *instrs = (Instr *)prog->instrs.data;
+	for (int i = prog->instrs.size - 1; i >= 0; --i) {
+		const Instr *ins = &instrs[i];
+		if (!live[ins->dst])
+			continue;
+		int regs[MAX_ARGC];
+		int nregs = instrOperands(prog, ins, regs);
+		for (int j = 0; j < nregs; ++j) {
+			live[regs[j]] = 1;
+		}
+	}
+
+	int size = 0;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		if (live[instrs[i].dst])
+			instrs[size++] = instrs[i];
+	}
+	if (size != prog->instrs.size)
+		debug("ɾ%dҪָ\n", prog->instrs.size - size);
+	prog->instrs.size = size;
+	/* ҪĳҲͷŵ */
+	for (int i = 0; i < prog->nregs; ++i) {
+		if (!live[i] && (prog->regFlags[i] & RF_OWN)) {
+			valueFree(prog->regs[i]);
+			prog->regs[i] = 0;
+			prog->regFlags[i] = 0;
+		}
+	}
+	free(live);
+	return 0;
+}
+
+Program *programCompileSet(Parser **ps, int n)
+{
+	Compiler c;
+	Program *prog = (Program *)malloc(sizeof(*prog));
+	if (!prog)
+		return 0;
+	memset(prog, 0, sizeof(*prog));
+	arrayInit(&prog->instrs, sizeof(Instr), 32);
+	arrayInit(&prog->operands, sizeof(int), 32);
+	arrayInit(&prog->fused, sizeof(FusedExpr), 4);
+
+	c.prog = prog;
+	arrayInit(&c.regs, sizeof(Value *), 32);
+	arrayInit(&c.flags, sizeof(unsigned char), 32);
+	hashTableInit(&c.exprs, 64, exprKeyCmp, exprKeyHash);
+	arrayInit(&c.keys, sizeof(ExprKey *), 64);
+
+	for (int k = 0; k < n; ++k) {
+		assert(ps[k] && ps[k]->ast);
+		prog->nstmts += ps[k]->ast->stmts.size;
+	}
+	prog->stmtRegs = (int *)malloc(sizeof(int) * (prog->nstmts > 0 ? prog->nstmts : 1));
+	bool ok = prog->stmtRegs != 0;
+	/* йʽһŹӱʽ, ͬʽͬӱʽҲֻһ */
+	c.stmtBase = 0;
+	for (int k = 0; ok && k < n; ++k) {
+		Parser *p = ps[k];
+		Stmt **arr = (Stmt **)p->ast->stmts.data;
+		c.p = p;
+		c.nstmts = 0;
+		for (int i = 0; i < p->ast->stmts.size; ++i) {
+			int r = compileExpr(&c, arr[i]->expr);
+			if (r < 0) {
+				ok = false;
+				break;
+			}
+			prog->stmtRegs[c.stmtBase + i] = r;
+			c.nstmts++;
+		}
+		c.stmtBase += p->ast->stmts.size;
+	}
+	if (ok)
+		ok = !addFloatOutputs(&c, ps, n);
+
+	for (int i = 0; i < c.keys.size; ++i) {
+		free(*(ExprKey **)arrayGet(&c.keys, i));
+	}
+	arrayFree(&c.keys);
+	hashTableFree(&c.exprs);
+
+	/* ĴProgramӹ */
+	prog->nregs = c.regs.size;
+	prog->regs = (Value **)c.regs.data;
+	prog->regFlags = (unsigned char *)c.flags.data;
+	if (ok) {
+		markOutputs(prog, ps, n);
+		ok = !programRemoveDead(prog);
+	}
+	if (ok)
+		ok = !programSimplify(prog);
+	if (ok)
+		ok = !programMatchIdioms(prog);
+	if (ok)
+		ok = !programFuse(prog);
+	if (ok)
+		ok = !programTrimSources(prog);
+	if (ok)
+		ok = !programShareBuffers(prog);
+	if (ok && prog->maxArgc > 0) {
+		prog->argv = (const Value **)malloc(sizeof(Value *) * prog->maxArgc);
+		ok = prog->argv != 0;
+	}
+	if (ok) {
+		prog->seen = (unsigned int *)calloc(prog->instrs.size > 0 ? prog->instrs.size : 1, sizeof(unsigned int));
+		ok = prog->seen != 0;
+	}
+	if (!ok) {
+		programFree(prog);
+		return 0;
+	}
+	debug("õ%dָ,%dĴ\n", prog->instrs.size, prog->nregs);
+	return prog;
+}
+
+Program *programCompile(Parser *p)
+{
+	assert(p && p->ast);
+	return programCompileSet(&p, 1);
+}
+
+void programFree(Program *prog)
+{
+	if (!prog)
+		return;
+	for (int i = 0; i < prog->nregs; ++i) {
+		if (prog->regFlags[i] & RF_OWN)
+			valueFree(prog->regs[i]);
+	}
+	free(prog->regs);
+	free(prog->regFlags);
+	free(prog->argv);
+	free(prog->seen);
+	free(prog->regBuf);
+	for (int b = 0; b < prog->nbufs; ++b)
+		valueFree(prog->bufs[b]);
+	free(prog->bufs);
+	free(prog->stmtRegs);
+	jitFree(prog->jit);
+	arrayFree(&prog->fused);
+	arrayFree(&prog->instrs);
+	arrayFree(&prog->operands);
+	free(prog);
+}
+
+/* ָĵj: shrinkԪ(ںREF), Ҫ
+ * needԪ(KʱһҲҪ¼). ֪ʱfalse */
+static bool operandWindow(const Program *prog, const Instr *ins, int j, int *shrink, int *need)
+{
+	*shrink = 0;
+	*need = 2;
+	switch (ins->op) {
+	case OP_CALL: /* עĺ֪ȡ */
+		return false;
+	case OP_REF:
+		*shrink = ins->n;
+		*need = ins->n + 2;
+		return true;
+	case OP_HHV:
+	case OP_LLV:
+	case OP_MA:
+		*shrink = ins->n - 1;
+		*need = ins->n + 1;
+		return true;
+	case OP_RSV: /* C,H,L, ȡֵ */
+		if (j > 0) {
+			*shrink = ins->n - 1;
+			*need = ins->n + 1;
+		}
+		return true;
+	case OP_FUSED:
+	case OP_JIT_FUSED: {
+		const FusedExpr *fe = (const FusedExpr *)arrayGet((Array *)&prog->fused, ins->n);
+		*shrink = fe->shifts[j];
+		*need = fe->shifts[j] + 2;
+		return true;
+	}
+	default: /* Ԫ͵, Ƶһֵ״̬ */
+		return true;
+	}
+}
+
+int programLookback(const Program *prog)
+{
+	/* off[r]: ĴrٵԪظ, DAGۼ */
+	int *off = (int *)calloc(prog->nregs > 0 ? prog->nregs : 1, sizeof(int));
+	if (!off)
+		return 0;
+	int lookback = 1;
+	const Instr *instrs = (const Instr *)prog->instrs.data;
+	for (int i = 0; i < prog->instrs.size; ++i) {
+		const Instr *ins = &instrs[i];
+		int regs[MAX_ARGC];
+		int nregs = instrOperands(prog, ins, regs);
+		int dst = 0;
+		for (int j = 0; j < nregs; ++j) {
+			int shrink, need;
+			if (!operandWindow(prog, ins, j, &shrink, &need)) {
+				free(off);
+				return 0;
+			}
+			if (off[regs[j]] + shrink > dst)
+				dst = off[regs[j]] + shrink;
+			if (off[regs[j]] + need > lookback)
+				lookback = off[regs[j]] + need;
+		}
+		off[ins->dst] = dst;
+		if (dst + 2 > lookback)
+			lookback = dst + 2;
+	}
+	free(off);
+	return lookback;
+}
+
+/* ------  ------ */
+
+/* ------ пʼ ------ */
+
+int instrOperands(const Program *prog, const Instr *ins, int *regs)
+{
+	switch (ins->op) {
+	case OP_VAR:
+		return 0;
+	case OP_CALL:
+	case OP_FUSED:
+	case OP_JIT_FUSED:
+	case OP_RSI:
+	case OP_RSV:
+	case OP_DIF: {
+		const int *operands = (const int *)prog->operands.data;
+		for (int j = 0; j < ins->b; ++j) {
+			regs[j] = operands[ins->a + j];
+		}
+		return ins->b;
+	}
+	case OP_ADD:
+	case OP_SUB:
+	case OP_MUL:
+	case OP_DIV:
+	case OP_ARITH_AA:
+		regs[0] = ins->a;
+		regs[1] = ins->b;
+		return 2;
+	default:
+		regs[0] = ins->a;
+		return 1;
+	}
+}
+
+/* ADDһ, 鲻 */
+static inline Value *arithAA(const Value *X, const Value *Y, char op, Value *R)
+{
+	if (X->size == 0 || Y->size == 0)
+		return R;
+	return suanShuYunSuan_AA(X, Y, op, R);
+}
+
+static inline Value *arithAN(const Value *X, double Y, char op, Value *R)
+{
+	if (X->size == 0)
+		return R;
+	return suanShuYunSuan_AN(X, Y, op, R);
+}
+
+static inline Value *arithNA(double X, const Value *Y, char op, Value *R)
+{
+	if (Y->size == 0)
+		return R;
+	return suanShuYunSuan_NA(X, Y, op, R);
+}
+
+int programRun(Program *prog, Parser *p)
+{
+	Value **R = prog->regs;
+	const int *operands = (const int *)prog->operands.data;
+	const Instr *ins = (const Instr *)prog->instrs.data;
+	const Instr *end = ins + prog->instrs.size;
+	unsigned int *seen = prog->seen;
+
+	for (; ins != end; ++ins, ++seen) {
+		int buf = prog->regBuf[ins->dst];
+		bool changed = true;
+		if (ins->op != OP_VAR) {
+			/* 붼ûб仯ʱҲ, ֻCLOSE仯ʱHHV(HIGH,N) */
+			int regs[MAX_ARGC];
+			int n = instrOperands(prog, ins, regs);
+			unsigned int sum = 1;
+			for (int i = 0; i < n; ++i) {
+				/* ͼõڴ滻˵ַʱ汾, ͼREFǰѾ¼ */
+				assert(!R[regs[i]] || valueViewValid(R[regs[i]]));
+				sum += valueVersion(R[regs[i]]);
+			}
+			/* עĺܶȡparserе״̬, ֻнɲĲ */
+			changed = *seen != sum || (ins->op == OP_CALL && !ins->n);
+			/* õĻѾ, ȻҪ, 汾 */
+			if (!changed && buf < 0)
+				continue;
+			*seen = sum;
+			if (buf >= 0 && R[ins->dst])
+				valueBorrow(R[ins->dst], prog->bufs[buf]);
+		}
+		switch (ins->op) {
+		case OP_VAR:
+			R[ins->dst] = ins->fn(p, 0, 0, 0);
+			break;
+		case OP_CALL: {
+			const int *args = &operands[ins->a];
+			for (int i = 0; i < ins->b; ++i) {
+				prog->argv[i] = R[args[i]];
+			}
+			R[ins->dst] = ins->fn(p, ins->b, prog->argv, R[ins->dst]);
+			break;
+		}
+		case OP_ADD: R[ins->dst] = ADD(R[ins->a], R[ins->b], R[ins->dst]); break;
+		case OP_SUB: R[ins->dst] = SUB(R[ins->a], R[ins->b], R[ins->dst]); break;
+		case OP_MUL: R[ins->dst] = MUL(R[ins->a], R[ins->b], R[ins->dst]); break;
+		case OP_DIV: R[ins->dst] = DIV(R[ins->a], R[ins->b], R[ins->dst]); break;
+		case OP_ARITH_AA: R[ins->dst] = arithAA(R[ins->a], R[ins->b], (char)ins->n, R[ins->dst]); break;
+		case OP_ARITH_AN: R[ins->dst] = arithAN(R[ins->a], ins->f, (char)ins->n, R[ins->dst]); break;
+		case OP_ARITH_NA: R[ins->dst] = arithNA(ins->f, R[ins->a], (char)ins->n, R[ins->dst]); break;
+		case OP_REF: R[ins->dst] = REF(R[ins->a], ins->n, R[ins->dst]); break;
+		case OP_MAX: R[ins->dst] = MAX(R[ins->a], ins->f, R[ins->dst]); break;
+		case OP_ABS: R[ins->dst] = ABS(R[ins->a], R[ins->dst]); break;
+		case OP_HHV: R[ins->dst] = HHV(R[ins->a], ins->n, R[ins->dst]); break;
+		case OP_LLV: R[ins->dst] = LLV(R[ins->a], ins->n, R[ins->dst]); break;
+		case OP_MA: R[ins->dst] = MA(R[ins->a], ins->n, R[ins->dst]); break;
+		case OP_EMA: R[ins->dst] = EMA(R[ins->a], ins->n, R[ins->dst]); break;
+		case OP_SMA: R[ins->dst] = SMA(R[ins->a], ins->n, ins->m, R[ins->dst]); break;
+		case OP_RSI: {
+			const int *args = &operands[ins->a];
+			R[ins->dst] = idiomRSI(R[args[0]], ins->n, ins->m, ins->f, &R[args[1]], &R[args[2]], R[ins->dst]);
+			break;
+		}
+		case OP_RSV: {
+			const int *args = &operands[ins->a];
+			R[ins->dst] = idiomRSV(R[args[0]], R[args[1]], R[args[2]], ins->n, ins->f, R[ins->dst]);
+			break;
+		}
+		case OP_DIF: {
+			const int *args = &operands[ins->a];
+			R[ins->dst] = idiomDIF(R[args[0]], ins->n, ins->m, &R[args[1]], &R[args[2]], R[ins->dst]);
+			break;
+		}
+		case OP_FUSED: {
+			const int *args = &operands[ins->a];
+			for (int i = 0; i < ins->b; ++i) {
+				prog->argv[i] = R[args[i]];
+			}
+			const FusedExpr *fe = (const FusedExpr *)arrayGet(&prog->fused, ins->n);
+			R[ins->dst] = fusedRun(fe, prog->argv, 0, R[ins->dst]);
+			break;
+		}
+		case OP_JIT_FUSED: {
+			const int *args = &operands[ins->a];
+			for (int i = 0; i < ins->b; ++i) {
+				prog->argv[i] = R[args[i]];
+			}
+			const FusedExpr *fe = (const FusedExpr *)arrayGet(&prog->fused, ins->n);
+			R[ins->dst] = fusedRun(fe, prog->argv, (FusedLoopFn)prog->jit->fns[ins->m], R[ins->dst]);
+			break;
+		}
+		case OP_FLOAT32:
+			/* K߲ʱԴûн */
+			if (!R[ins->a])
+				break;
+			R[ins->dst] = FLOAT32(R[ins->a], R[ins->dst]);
+			if (ins->n)
+				valueTrim(R[ins->a], FLOAT_SOURCE_KEEP);
+			break;
+		case OP_JIT_RECUR:
+			R[ins->dst] = jitRecurRun(R[ins->a], (RecurLoopFn)prog->jit->fns[ins->b], R[ins->dst]);
+			break;
+		default:
+			assert(0);
+			return -1;
+		}
+		if (ins->op != OP_VAR && R[ins->dst]) {
+			if (buf >= 0)
+				valueGiveBack(R[ins->dst], prog->bufs[buf]);
+			if (changed)
+				R[ins->dst]->version++;
+		}
+	}
+	return 0;
+}
+
+size_t programSeriesBytes(const Program *prog)
+{
+	size_t bytes = 0;
+	for (int i = 0; i < prog->nregs; ++i) {
+		if (prog->regFlags[i] & RF_OWN)
+			bytes += valueSeriesBytes(prog->regs[i]);
+	}
+	for (int b = 0; b < prog->nbufs; ++b)
+		bytes += valueSeriesBytes(prog->bufs[b]);
+	return bytes;
+}
+
+Value *programStmtValue(Program *prog, int i)
+{
+	assert(prog && i >= 0 && i < prog->nstmts);
+	return prog->regs[prog->stmtRegs[i]];
+}
+
+void programRewind(Program *prog, int64_t no, int64_t last)
+{
+	for (int i = 0; i < prog->nregs; ++i) {
+		Value *v = prog->regs[i];
+		if (v && (prog->regFlags[i] & RF_OWN) && !(prog->regFlags[i] & RF_CONST))
+			valueRewindQuote(v, no, last);
+	}
+	/* ֱ޸ĵ, 汾ûб仯 */
+	memset(prog->seen, 0, sizeof(*prog->seen) * prog->instrs.size);
+}
+
+/* ------ н ------ */
+
+}
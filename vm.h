@@ -0,0 +1,225 @@
+#ifndef TG_INDICATOR_VM_H
+#define TG_INDICATOR_VM_H
+
+#include "base.h"
+#include "indicators.h"
+
+namespace tg {
+
+/* ------ ֽ뿪ʼ ------ */
+
+/* ASTԵָ, ÿмӦһŵļĴ(Value *),
+ * ʱ˳ִָ, ٵݹAST */
+
+enum OpCode {
+	OP_VAR, /* R[dst] = fn(parser)           ñ,CLOSE */
+	OP_CALL, /* R[dst] = fn(parser, argc, R[operands[a..a+b)], R[dst]) */
+	OP_ADD, /* R[dst] = R[a] + R[b] */
+	OP_SUB, /* R[dst] = R[a] - R[b] */
+	OP_MUL, /* R[dst] = R[a] * R[b] */
+	OP_DIV, /* R[dst] = R[a] / R[b] */
+	/* Ϊػָ: ͺͳڱʱȷ, ʱټ */
+	OP_ARITH_AA, /* R[dst] = R[a] n R[b]       nΪ'+','-','*','/' */
+	OP_ARITH_AN, /* R[dst] = R[a] n f */
+	OP_ARITH_NA, /* R[dst] = f n R[a] */
+	OP_REF, /* R[dst] = REF(R[a], n) */
+	OP_MAX, /* R[dst] = MAX(R[a], f) */
+	OP_ABS, /* R[dst] = ABS(R[a]) */
+	OP_HHV, /* R[dst] = HHV(R[a], n) */
+	OP_LLV, /* R[dst] = LLV(R[a], n) */
+	OP_MA, /* R[dst] = MA(R[a], n) */
+	OP_EMA, /* R[dst] = EMA(R[a], n) */
+	OP_SMA, /* R[dst] = SMA(R[a], n, m) */
+	OP_FUSED, /* R[dst] = fused[n](R[operands[a..a+b)]) ںϺԪ */
+	/* Ϊʶĳָд, operands[a..a+b)ͱ״̬ļĴ */
+	OP_RSI, /* R[dst] = SMA(MAX(X,0),n,m)/SMA(ABS(X),n,m)*f, operandsΪX,SMA */
+	OP_RSV, /* R[dst] = (C-LLV(L,n))/(HHV(H,n)-LLV(L,n))*f, operandsΪC,H,L */
+	OP_DIF, /* R[dst] = EMA(X,n)-EMA(X,m), operandsΪX,EMA */
+	OP_FLOAT32, /* R[dst] = FLOAT32(R[a])     float洢, parserSetPrecision.
+	             * nΪ1ʱR[a]ֻԪ, programTrimSources */
+	/* ΪJITɵĻ, mbΪjit->fnsе± */
+	OP_JIT_FUSED, /* ͬOP_FUSED, ѭΪjit->fns[m] */
+	OP_JIT_RECUR, /* R[dst] = EMA(R[a],n)SMA(R[a],n,m), ѭΪjit->fns[b] */
+	OP_ALL
+};
+
+struct Instr {
+	enum OpCode op;
+	int dst; /* Ĵ */
+	int a; /* Ĵ; OP_CALL/OP_FUSEDʱΪoperandsеĿʼλ */
+	int b; /* ҲĴ; OP_CALL/OP_FUSEDʱΪ */
+	ValueFn fn; /* OP_VAR/OP_CALLõĺ */
+	int n, m; /* ػָ; OP_CALLʱnΪ1ʾfnĽֻɲ */
+	double f; /* ػָĳ */
+};
+
+/* OP_FLOAT32nΪ1ʱR[a]Ԫظ: һKʱ¼, ƻҪȡһ */
+#define FLOAT_SOURCE_KEEP 2
+
+/* Ĵı־ */
+enum RegFlag {
+	RF_OWN = 1, /* ĴеValueProgramͷ */
+	RF_CONST = 2, /* ,ʱȷ */
+	RF_ARRAY = 4, /* ʱ֪ */
+	RF_OUTPUT = 8, /* ҪStmtĽ, Ż */
+};
+
+/* ------ ںϿʼ ------ */
+
+/* Ԫ(,MAX,ABS,REF)ɵıʽںϳһѭ,
+ * мдڴ. ׺ʽ˳ */
+
+enum FusedOpCode {
+	FC_LOAD, /* ѹinput */
+	FC_CONST, /* ѹ볣f */
+	FC_ADD, /* y,x, ѹx+y */
+	FC_SUB,
+	FC_MUL,
+	FC_DIV, /* yΪ0ʱΪNAN, DIVһ */
+	FC_MAX, /* x, ѹMAX(x,f) */
+	FC_ABS, /* x, ѹABS(x) */
+};
+
+#define MAX_FUSED_INPUTS 8
+#define MAX_FUSED_CODE 32
+#define MAX_FUSED_DEPTH 8
+
+struct FusedCode {
+	enum FusedOpCode op;
+	int input;
+	double f;
+};
+
+struct FusedExpr {
+	int ninputs;
+	int shifts[MAX_FUSED_INPUTS]; /* ÿ뱻REFǰƶλ, ı0һ */
+	int ncode;
+	FusedCode code[MAX_FUSED_CODE];
+};
+
+/* ںϺıʽɵĻ, base[j]Ϊjr[0]Ӧλ */
+typedef void (*FusedLoopFn)(const double *const *base, double *r, long n);
+
+/* ںϺıʽ, 밴˳inputs. loopΪ0ʱִ */
+Value *fusedRun(const FusedExpr *fe, const Value **inputs, FusedLoopFn loop, Value *R);
+
+/* ------ ںϽ ------ */
+
+/* ------ ָдʼ ------ */
+
+/* һѭָ, мھֲ, ֿĽȫһ.
+ * Ƶָ(SMA,EMA)Ҫһֵ, *SA,*SB״̬ */
+Value *idiomRSI(const Value *X, int N, int M, double K, Value **SA, Value **SB, Value *R);
+Value *idiomRSV(const Value *C, const Value *H, const Value *L, int N, double K, Value *R);
+Value *idiomDIF(const Value *X, int S, int L, Value **E1, Value **E2, Value *R);
+
+/* ------ ָд ------ */
+
+/* ------ JITʼ ------ */
+
+/* ںϺԪEMA/SMAĵƱx86-64, ڿִеڴ.
+ * ָȻ; ֵ֧ƽ̨ʲô */
+
+/* r[i] = (x[i]*a + r[i-1]*b) / c, ibeginend-1, begin > 0 */
+typedef void (*RecurLoopFn)(const double *x, double *r, long begin, long end);
+
+struct JitCode {
+	unsigned char *mem; /* ִеڴ */
+	long size;
+	int nfns;
+	void **fns; /* ÿ */
+};
+
+void jitFree(JitCode *jit);
+
+/* EMA/SMAһµ׼, ѭloop */
+Value *jitRecurRun(const Value *X, RecurLoopFn loop, Value *R);
+
+/* ------ JIT ------ */
+
+struct Program {
+	Array instrs; // Instr
+	Array operands; // int, OP_CALL/OP_FUSEDĲĴ
+	Array fused; // FusedExpr
+	int nregs;
+	Value **regs;
+	unsigned char *regFlags;
+	int maxArgc;
+	const Value **argv; /* OP_CALLõĻ */
+	int nstmts;
+	int *stmtRegs; /* ÿStmtĽڵļĴ */
+	JitCode *jit; /* programJitɵĻ */
+	/* ÿָϴμʱİ汾֮ͼ1, 0ʾҪ¼. ͬʱָ */
+	unsigned int *seen;
+	/* мõĻbufsе±, -1ʾԼڴ */
+	int *regBuf;
+	int nbufs;
+	Value **bufs;
+};
+
+class Parser;
+
+/* p->astֽ, ʧܷ0 */
+Program *programCompile(Parser *p);
+/* Ѷʽ뵽ͬһProgram, ʽStmtstmtRegs */
+Program *programCompileSet(Parser **ps, int n);
+void programFree(Program *prog);
+
+int programRun(Program *prog, Parser *p);
+
+/* ָȡļĴŵregs(MAX_ARGC), ظ */
+#define MAX_ARGC 16
+int instrOperands(const Program *prog, const Instr *ins, int *regs);
+
+/* ɾûõָ, ֻRF_OUTPUTļĴǸ */
+int programRemoveDead(Program *prog);
+
+/* ĴĶʹ, Żʱʹ */
+struct UseDef {
+	int *def; /* Ĵָ, -1ʾָĽ */
+	int *uses; /* Ĵָȡ */
+	int *user; /* һȡָ, ֻȡһʱΨһʹ */
+};
+int useDefInit(UseDef *ud, Program *prog);
+void useDefFree(UseDef *ud);
+/* regļָ, ûз0 */
+Instr *useDefInstr(UseDef *ud, Program *prog, int reg);
+/* ֻΪмʹnuses */
+bool useDefIsTemp(const UseDef *ud, const Program *prog, int reg, int nuses);
+
+/* ,  */
+int programSimplify(Program *prog);
+
+/* ʶ𳣼ָд, רŵָ */
+int programMatchIdioms(Program *prog);
+
+/* ԪָںϳOP_FUSED */
+int programFuse(Program *prog);
+
+/* Ĵһ, ڲصмһ, valueBorrow.
+ * StmtĽ͵Ƶ״̬ȻԱ */
+int programShareBuffers(Program *prog);
+/* ֻOP_FLOAT32ȡdoubleתֻԪ(valueTrim), ڴֻʣfloatһ.
+ * programShareBuffers֮ǰ, Щٹû */
+int programTrimSources(Program *prog);
+/* м(õĻ)ռõֽ,  */
+size_t programSeriesBytes(const Program *prog);
+
+/* ܱɻָOP_JIT_XXX, رĸ, ʧܷ-1 */
+int programJit(Program *prog);
+
+/* iStmtĽ */
+Value *programStmtValue(Program *prog, int i);
+/* ̬ʽȡٸK: REFλƺHHV,LLV,MAĴDAGۼ,
+ * ټ¼һKҪ1. 鱣ôܵõͬĽ(valueSetKeep).
+ * в֪ڵĺ(ǳ)ʱ0, ʾҪȫ */
+int programLookback(const Program *prog);
+/* ´ʱнınoʼ¼(valueRewindQuote), noΪ0ʱͷ,
+ * lastϴʱһKߵı. ں˵״̬֮ؽ. ı(OP_VAR) */
+void programRewind(Program *prog, int64_t no, int64_t last);
+
+/* ------ ֽ ------ */
+
+}
+
+#endif